@@ -1,29 +1,84 @@
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
 #include <ctime>
+#include <memory>
 #include <SFML/Graphics.hpp>
 #include "src/grid.h"
+#include "src/alloc_tracker.h"
+#include "src/capture.h"
+#include "src/engine.h"
+#include "src/spectator.h"
+#include "src/training.h"
+#include "src/versus.h"
 
 const size_t BLOCK_SIZE = 100;  // size in pixels
 const size_t WIDTH  = 15;      // size in blocks/grid sections
 const size_t HEIGHT = 20;      // size in blocks/grid sections
-size_t SCORE  = 0;
+const char* TELEMETRY_PATH = "telemetry.jsonl";  // appended to every session
 
-int main() {
+int main(int argc, char** argv) {
 	srand(time(0));
+	// --spectate [boards] shows a wall of bot games instead of a playable one
+	if (argc > 1 && strcmp(argv[1], "--spectate") == 0) {
+		runSpectator(argc > 2 ? (size_t)atoi(argv[2]) : 100);
+		return 0;
+	}
+	// --versus [delay ms] [loss %] plays against a bot over a simulated laggy link
+	if (argc > 1 && strcmp(argv[1], "--versus") == 0) {
+		runVersus(argc > 2 ? atoi(argv[2]) : 100, argc > 3 ? atoi(argv[3]) : 5);
+		return 0;
+	}
+	// --versus-harness [delay ms] [loss %] [frames] runs two bots headless and reports rollback cost
+	if (argc > 1 && strcmp(argv[1], "--versus-harness") == 0) {
+		runVersusHarness(argc > 2 ? atoi(argv[2]) : 100, argc > 3 ? atoi(argv[3]) : 5, argc > 4 ? atoi(argv[4]) : 36000);
+		return 0;
+	}
+	// --selfplay <file> [games] [threads] exports bot placements as training data
+	if (argc > 2 && strcmp(argv[1], "--selfplay") == 0) {
+		runSelfPlay(argv[2], argc > 3 ? (size_t)atoi(argv[3]) : 100, argc > 4 ? (size_t)atoi(argv[4]) : std::thread::hardware_concurrency());
+		return 0;
+	}
+
+	// --engine [games] [budget ms] serves games to an external bot on stdin/stdout
+	if (argc > 1 && strcmp(argv[1], "--engine") == 0) {
+		runEngineServer(argc > 2 ? (size_t)atoi(argv[2]) : 10, argc > 3 ? atoi(argv[3]) : 100);
+		return 0;
+	}
+	// --engine-selftest [games] [budget ms] serves them to the built-in bot over pipes
+	if (argc > 1 && strcmp(argv[1], "--engine-selftest") == 0) {
+		runEngineSelfTest(argc > 2 ? (size_t)atoi(argv[2]) : 10, argc > 3 ? atoi(argv[3]) : 100);
+		return 0;
+	}
+
 	int realWidth  = (int) BLOCK_SIZE * WIDTH;
 	int realHeight = (int) BLOCK_SIZE * HEIGHT;
 
 	sf::RenderWindow window(sf::VideoMode(realWidth, realHeight), "Tetris");
 	window.setKeyRepeatEnabled(false);
 
+	Telemetry telemetry(TELEMETRY_PATH);
+	telemetry.record(TelemetryType::GameStart, 0);
+
 	GameGrid Grid; //Width, height, and block size
 	Grid.setWindow(window);
+	Grid.setTelemetry(telemetry);
+	Grid.seed(time(0));
 	Grid.spawnNewPiece();
 
+	// --capture <dir> [raw] records the game as an image sequence while playing
+	std::unique_ptr<FrameCapture> capture;
+	if (argc > 2 && strcmp(argv[1], "--capture") == 0) {
+		bool raw = argc > 3 && strcmp(argv[3], "raw") == 0;
+		capture.reset(new FrameCapture(argv[2], raw ? CaptureFormat::Raw : CaptureFormat::Png));
+	}
+
 	sf::Clock clock;
+	sf::Clock frameClock;
 	sf::Time time;
+	AllocProfile allocProfile;
 	while (window.isOpen()) {
+		AllocScope frameAllocs;
        // event management
         sf::Event event;
         while (window.pollEvent(event)) {
@@ -42,12 +97,18 @@ int main() {
 			if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) {
 			    Grid.pieceLeft();
 			}
+			// once per press, isKeyPressed would fire for every event that arrives while Z is held
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Z) {
+			    Grid.rewind();
+			}
         }
 
         time = clock.getElapsedTime();
         if (time.asSeconds() > 0.5) {
+        	AllocScope stepAllocs;
         	Grid.pieceDown();
         	clock.restart();
+        	allocProfile.addStep(stepAllocs.delta());
         }
 
         if (Grid.checkForGameOver())
@@ -55,7 +116,20 @@ int main() {
         window.clear(sf::Color(82, 86, 87, 56));
         Grid.drawGrid();
         window.display();
+        if (capture) {
+        	capture->captureFrame(Grid);
+        }
+        telemetry.record(TelemetryType::Frame, frameClock.restart().asMicroseconds());
+        AllocCounts allocs = frameAllocs.delta();
+        if (ALLOC_TRACKING) telemetry.record(TelemetryType::Allocs, allocs.bytes, allocs.count);
+        allocProfile.addFrame(allocs);
+    }
+    telemetry.record(TelemetryType::GameOver, Grid.getScore());
+    allocProfile.report(std::cout);
+    if (capture) {
+    	capture->finish();
+    	capture->report(std::cout);
     }
-    std::cout << "Game Over with a Score of: " << SCORE << std::endl;
+    std::cout << "Game Over with a Score of: " << Grid.getScore() << std::endl;
     return 0;
 }
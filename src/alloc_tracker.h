@@ -0,0 +1,149 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Heap allocation tracking for debug / benchmark builds.
+// Compile with -DTRACK_ALLOCATIONS to hook global new/delete, add -DALLOC_STRICT to abort
+// as soon as a steady-state frame or step goes over its budget. Without the flags every count stays zero.
+// Must only be included from one translation unit (main.cpp), it defines the global operators.
+
+struct AllocCounts {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+// counts for the calling thread, so the telemetry writer etc. don't pollute the game thread
+thread_local AllocCounts threadAllocs = {0, 0};
+// counts for the whole process
+std::atomic<uint64_t> totalAllocCount(0);
+std::atomic<uint64_t> totalAllocBytes(0);
+
+#ifdef TRACK_ALLOCATIONS
+const bool ALLOC_TRACKING = true;
+
+void* trackedAlloc(std::size_t size, std::size_t alignment = 0) {
+    ++threadAllocs.count;
+    threadAllocs.bytes += size;
+    totalAllocCount.fetch_add(1, std::memory_order_relaxed);
+    totalAllocBytes.fetch_add(size, std::memory_order_relaxed);
+    void* ptr = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        ptr = std::malloc(size ? size : 1);
+    } else if (posix_memalign(&ptr, alignment, size ? size : 1) != 0) {
+        ptr = nullptr;
+    }
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* trackedAllocNothrow(std::size_t size, std::size_t alignment = 0) noexcept {
+    try {
+        return trackedAlloc(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(std::size_t size) { return trackedAlloc(size); }
+void* operator new[](std::size_t size) { return trackedAlloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return trackedAllocNothrow(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return trackedAllocNothrow(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+// over-aligned types (alignas above max_align_t) come through these, posix_memalign'd memory is also freed with free
+void* operator new(std::size_t size, std::align_val_t al) { return trackedAlloc(size, (std::size_t)al); }
+void* operator new[](std::size_t size, std::align_val_t al) { return trackedAlloc(size, (std::size_t)al); }
+void* operator new(std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return trackedAllocNothrow(size, (std::size_t)al); }
+void* operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return trackedAllocNothrow(size, (std::size_t)al); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+#else
+const bool ALLOC_TRACKING = false;
+#endif
+
+#ifdef ALLOC_STRICT
+const bool ALLOC_STRICT_MODE = true;
+#else
+const bool ALLOC_STRICT_MODE = false;
+#endif
+
+// measures the allocations made by the current thread between construction and delta()
+class AllocScope {
+   private:
+    AllocCounts _start;
+
+   public:
+    AllocScope() : _start(threadAllocs) {}
+    AllocCounts delta() const { return {threadAllocs.count - _start.count, threadAllocs.bytes - _start.bytes}; }
+};
+
+// per frame / per simulation step bookkeeping for the game loop
+class AllocProfile {
+   private:
+    // frames before this are loading / first spawn and are not held to a budget
+    uint64_t    _warmupFrames;
+    // allocations allowed per steady-state frame and per simulation step
+    uint64_t    _frameBudget, _stepBudget;
+    uint64_t    _frames, _steps;
+    AllocCounts _frameTotal, _stepTotal;
+    AllocCounts _worstFrame, _worstStep;
+    uint64_t    _allocatingFrames;
+
+    void violation(const char* what, const AllocCounts& counts) const {
+        std::cerr << "allocations over budget in steady-state " << what << " (frame " << _frames << "): " << counts.count << " allocs, "
+                  << counts.bytes << " bytes" << std::endl;
+        std::abort();
+    }
+
+   public:
+    AllocProfile(uint64_t warmupFrames = 60, uint64_t frameBudget = 0, uint64_t stepBudget = 0)
+        : _warmupFrames(warmupFrames), _frameBudget(frameBudget), _stepBudget(stepBudget), _frames(0), _steps(0), _frameTotal{0, 0}, _stepTotal{0, 0}, _worstFrame{0, 0},
+          _worstStep{0, 0}, _allocatingFrames(0) {}
+
+    bool steady() const { return _frames >= _warmupFrames; }
+
+    void addFrame(const AllocCounts& counts) {
+        bool wasSteady = steady();
+        ++_frames;
+        _frameTotal.count += counts.count;
+        _frameTotal.bytes += counts.bytes;
+        if (counts.count > _worstFrame.count) _worstFrame = counts;
+        if (counts.count > 0) ++_allocatingFrames;
+        if (ALLOC_STRICT_MODE && wasSteady && counts.count > _frameBudget) violation("frame", counts);
+    }
+
+    void addStep(const AllocCounts& counts) {
+        ++_steps;
+        _stepTotal.count += counts.count;
+        _stepTotal.bytes += counts.bytes;
+        if (counts.count > _worstStep.count) _worstStep = counts;
+        if (ALLOC_STRICT_MODE && steady() && counts.count > _stepBudget) violation("step", counts);
+    }
+
+    void report(std::ostream& os) const {
+        if (!ALLOC_TRACKING) return;
+        os << "Allocations: " << _frames << " frames, " << _allocatingFrames << " allocating, " << _frameTotal.count << " allocs / "
+           << _frameTotal.bytes << " bytes total, worst frame " << _worstFrame.count << " allocs / " << _worstFrame.bytes
+           << " bytes" << std::endl;
+        os << "Allocations: " << _steps << " steps, " << _stepTotal.count << " allocs / " << _stepTotal.bytes
+           << " bytes total, worst step " << _worstStep.count << " allocs / " << _worstStep.bytes << " bytes" << std::endl;
+        os << "Allocations: process total " << totalAllocCount.load() << " allocs / " << totalAllocBytes.load() << " bytes"
+           << std::endl;
+    }
+};
+
+#endif
@@ -4,20 +4,32 @@
 #include <SFML/Graphics.hpp>
 #include <stdlib.h>
 #include <string>
-#include "piece.h"
 
 // size of each block in pixels. declared above main.cpp
 extern const size_t BLOCK_SIZE;
 
+// compact color codes used when blocks are stored by value (see board.h), 0 means empty
+enum BlockColor : unsigned char { NO_BLOCK, RED_BLOCK, BLUE_BLOCK, MAGENTA_BLOCK, GREEN_BLOCK, YELLOW_BLOCK, WHITE_BLOCK, BLACK_BLOCK };
+
+// conversions between the color names used by Block/Piece and the compact codes
+unsigned char blockColorCode(const std::string& color);
+std::string blockColorName(unsigned char code);
+sf::Color blockColor(unsigned char code);
+
 class Block : public sf::Sprite {
 protected:
 	// absolute x and y pos in grid coords
 	size_t x_pos, y_pos;
-	// texture loaded and set in the constructor
-	sf::Texture blockTexture;
+
+	static sf::Texture loadTexture();
 
 public:
-	// constructs block with x and y grid position
+	// texture shared by every block, loaded from disk on first use
+	// also used directly as the atlas for batched drawing
+	static const sf::Texture& sharedTexture();
+
+	// constructs block with the given color, the texture is only attached on the first draw
+	// so headless simulations never touch sf::Texture
 	Block(std::string color);
 
 	void SetColor(std::string color);
@@ -34,41 +46,100 @@ public:
 	void left();
 
 	// draws the object, called from Piece classes
-	void drawBlock(sf::RenderWindow& win);
+	void drawBlock(sf::RenderTarget& win);
 };
 
-void Block::SetColor(std::string color) {
+unsigned char blockColorCode(const std::string& color) {
 	if (color == "red") {
-		this->setColor(sf::Color::Red);
+		return RED_BLOCK;
 	} else if (color == "blue") {
-		this->setColor(sf::Color::Blue);
+		return BLUE_BLOCK;
 	} else if (color == "magenta") {
-		this->setColor(sf::Color::Magenta);
+		return MAGENTA_BLOCK;
 	} else if (color == "green") {
-		this->setColor(sf::Color::Green);
+		return GREEN_BLOCK;
 	} else if (color == "yellow") {
-		this->setColor(sf::Color::Yellow);
+		return YELLOW_BLOCK;
 	} else if (color == "white") {
-		this->setColor(sf::Color::White);
+		return WHITE_BLOCK;
 	} else if (color == "black") {
-		this->setColor(sf::Color::Black);
+		return BLACK_BLOCK;
 	} else {
 		throw std::invalid_argument("invalid color argument");
 	}
 }
 
-Block::Block(std::string color) {
-	if (!blockTexture.loadFromFile("icons/block.png")) { 
-		throw std::invalid_argument("icon cant be opened"); 
+std::string blockColorName(unsigned char code) {
+	switch (code) {
+		case RED_BLOCK:
+			return "red";
+		case BLUE_BLOCK:
+			return "blue";
+		case MAGENTA_BLOCK:
+			return "magenta";
+		case GREEN_BLOCK:
+			return "green";
+		case YELLOW_BLOCK:
+			return "yellow";
+		case WHITE_BLOCK:
+			return "white";
+		case BLACK_BLOCK:
+			return "black";
+		default:
+			throw std::invalid_argument("invalid color code");
 	}
+}
+
+sf::Color blockColor(unsigned char code) {
+	switch (code) {
+		case RED_BLOCK:
+			return sf::Color::Red;
+		case BLUE_BLOCK:
+			return sf::Color::Blue;
+		case MAGENTA_BLOCK:
+			return sf::Color::Magenta;
+		case GREEN_BLOCK:
+			return sf::Color::Green;
+		case YELLOW_BLOCK:
+			return sf::Color::Yellow;
+		case WHITE_BLOCK:
+			return sf::Color::White;
+		case BLACK_BLOCK:
+			return sf::Color::Black;
+		default:
+			return sf::Color::Transparent;
+	}
+}
+
+void Block::SetColor(std::string color) {
+	this->setColor(blockColor(blockColorCode(color)));
+}
+
+sf::Texture Block::loadTexture() {
+	sf::Texture texture;
+	if (!texture.loadFromFile("icons/block.png")) {
+		throw std::invalid_argument("icon cant be opened");
+	}
+	return texture;
+}
+
+const sf::Texture& Block::sharedTexture() {
+	// initialized once, safe to reach from simulation threads
+	static const sf::Texture texture = loadTexture();
+	return texture;
+}
+
+Block::Block(std::string color) {
 	SetColor(color);
 	// for the scale. 118 pixels is size of original image
 	float BlockSize = BLOCK_SIZE / 118.f;
-	this->setTexture(blockTexture);
 	this->setScale(BlockSize, BlockSize);
 }
 
-void Block::drawBlock(sf::RenderWindow& win) {
+void Block::drawBlock(sf::RenderTarget& win) {
+	if (this->getTexture() == nullptr) {
+		this->setTexture(sharedTexture());
+	}
 	win.draw(*this);
 }
 
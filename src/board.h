@@ -0,0 +1,242 @@
+#ifndef BOARD_H
+#define BOARD_H
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "block.h"
+
+// rows per storage chunk, tall boards are many modest allocations instead of one huge array
+const size_t BOARD_CHUNK_ROWS = 64;
+
+// what removeRow(y) changes: the storage row behind y moves up to `top` and the rows in between
+// shift down by one, Board::restoreRow takes it back
+struct RowRemoval {
+    uint32_t y, slot, top;
+};
+
+// value type holding the locked blocks of a GameGrid
+// each cell is a BlockColor code, NO_BLOCK when empty. cells live in fixed size chunks of rows and
+// a row map translates board rows to storage rows, so removing a row only shuffles row numbers
+// instead of moving every cell above it. each row keeps its number of occupied cells and full rows
+// are indexed, so finding and clearing lines costs the rows involved rather than the whole board
+class Board {
+   private:
+    size_t                                  _width, _height;
+    std::vector<std::vector<unsigned char>> _chunks;
+    // board row -> storage row and back
+    std::vector<uint32_t> _rowMap, _rowOf;
+    // occupied cells per storage row
+    std::vector<uint32_t> _fill;
+    // storage rows that are completely occupied, unordered
+    std::vector<uint32_t> _full;
+    // every row above _top is empty, empty rows are interchangeable so removing a row only
+    // renumbers the rows between _top and the removed one
+    size_t _top;
+
+    unsigned char* row(size_t y) {
+        uint32_t slot = _rowMap[y];
+        return &_chunks[slot / BOARD_CHUNK_ROWS][(slot % BOARD_CHUNK_ROWS) * _width];
+    }
+    const unsigned char* row(size_t y) const {
+        uint32_t slot = _rowMap[y];
+        return &_chunks[slot / BOARD_CHUNK_ROWS][(slot % BOARD_CHUNK_ROWS) * _width];
+    }
+    // keeps _full in step with a storage row's new fill count
+    void setFill(uint32_t slot, uint32_t fill);
+
+   public:
+    Board(size_t width, size_t height);
+    // copies keep the full-row index reserved, see copyFrom
+    Board(const Board& other) : Board(other._width, other._height) { copyFrom(other); }
+    Board& operator=(const Board& other);
+
+    size_t width() const { return _width; }
+    size_t height() const { return _height; }
+
+    unsigned char get(size_t x, size_t y) const { return row(y)[x]; }
+    bool isBlock(size_t x, size_t y) const { return row(y)[x] != NO_BLOCK; }
+    void set(size_t x, size_t y, unsigned char color);
+    // the width() cells of row y, valid until the row map changes
+    const unsigned char* rowCells(size_t y) const { return row(y); }
+
+    // number of occupied cells in row y
+    size_t rowCount(size_t y) const { return _fill[_rowMap[y]]; }
+    // true if every cell in row y is occupied
+    bool rowFull(size_t y) const { return _fill[_rowMap[y]] == _width; }
+    bool rowEmpty(size_t y) const { return _fill[_rowMap[y]] == 0; }
+    // every row above this one is empty, height() for an empty board
+    size_t top() const { return _top; }
+    // number of full rows and the bottom-most of them, -1 when there are none
+    size_t fullRows() const { return _full.size(); }
+    int lowestFullRow() const;
+
+    // sets every cell in row y to color
+    void fillRow(size_t y, unsigned char color);
+    // removes row y, everything above moves down one and the top row becomes empty
+    void removeRow(size_t y);
+    // the row map change removeRow(y) would make right now
+    RowRemoval removal(size_t y) const { return {(uint32_t)y, _rowMap[y], (uint32_t)_top}; }
+    // undoes a removeRow and gives the row back its cells, removals must be undone newest first
+    // on the board they were made on
+    void restoreRow(const RowRemoval& removal, const unsigned char* cells);
+    // pushes everything up by `rows` (the top rows are lost) and fills the bottom rows
+    // with color, leaving column `hole` empty in each of them
+    void raise(size_t rows, size_t hole, unsigned char color);
+    // empties the whole board
+    void clear();
+
+    // FNV-1a hash of the cells in board order, used to detect desyncs between simulations
+    uint32_t checksum() const;
+
+    // copies another board of the same size without reallocating
+    void copyFrom(const Board& other);
+};
+
+Board::Board(size_t width, size_t height)
+    : _width(width), _height(height), _rowMap(height), _rowOf(height), _fill(height, 0), _top(height) {
+    size_t chunks = (height + BOARD_CHUNK_ROWS - 1) / BOARD_CHUNK_ROWS;
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t rows = std::min(BOARD_CHUNK_ROWS, height - c * BOARD_CHUNK_ROWS);
+        _chunks.emplace_back(rows * width, NO_BLOCK);
+    }
+    for (size_t y = 0; y < height; ++y) {
+        _rowMap[y] = _rowOf[y] = (uint32_t)y;
+    }
+    // every row could be full at once, reserving keeps set() and copyFrom() off the heap
+    _full.reserve(height);
+}
+
+Board& Board::operator=(const Board& other) {
+    // memberwise, vectors of matching size reuse their storage
+    _width = other._width;
+    _height = other._height;
+    _chunks = other._chunks;
+    _rowMap = other._rowMap;
+    _rowOf = other._rowOf;
+    _fill = other._fill;
+    _full.reserve(_height);
+    _full.assign(other._full.begin(), other._full.end());
+    _top = other._top;
+    return *this;
+}
+
+void Board::setFill(uint32_t slot, uint32_t fill) {
+    bool wasFull = _fill[slot] == _width;
+    bool isFull = fill == _width;
+    _fill[slot] = fill;
+    if (isFull && !wasFull) {
+        _full.push_back(slot);
+    } else if (wasFull && !isFull) {
+        _full.erase(std::find(_full.begin(), _full.end(), slot));
+    }
+}
+
+void Board::set(size_t x, size_t y, unsigned char color) {
+    unsigned char& cell = row(y)[x];
+    uint32_t       slot = _rowMap[y];
+    if ((cell == NO_BLOCK) != (color == NO_BLOCK)) {
+        setFill(slot, color == NO_BLOCK ? _fill[slot] - 1 : _fill[slot] + 1);
+    }
+    cell = color;
+    if (color != NO_BLOCK) _top = std::min(_top, y);
+}
+
+int Board::lowestFullRow() const {
+    int lowest = -1;
+    for (uint32_t slot : _full) {
+        lowest = std::max(lowest, (int)_rowOf[slot]);
+    }
+    return lowest;
+}
+
+void Board::fillRow(size_t y, unsigned char color) {
+    std::fill_n(row(y), _width, color);
+    setFill(_rowMap[y], color == NO_BLOCK ? 0 : (uint32_t)_width);
+    if (color != NO_BLOCK) _top = std::min(_top, y);
+}
+
+void Board::removeRow(size_t y) {
+    fillRow(y, NO_BLOCK);
+    if (y < _top) return;
+    // the occupied rows above y shift down by one number and the emptied storage row goes on top
+    // of them, cells never move and the empty rows above _top are left alone
+    uint32_t slot = _rowMap[y];
+    std::copy_backward(_rowMap.begin() + _top, _rowMap.begin() + y, _rowMap.begin() + y + 1);
+    _rowMap[_top] = slot;
+    for (size_t r = _top; r <= y; ++r) {
+        _rowOf[_rowMap[r]] = (uint32_t)r;
+    }
+    ++_top;
+}
+
+void Board::restoreRow(const RowRemoval& removal, const unsigned char* cells) {
+    size_t y = removal.y, top = removal.top;
+    if (y >= top) {
+        if (_rowMap[top] != removal.slot) {
+            throw std::invalid_argument("rows restored out of order");
+        }
+        // the reverse of removeRow, the rows between shift back up and the slot returns to y
+        std::copy(_rowMap.begin() + top + 1, _rowMap.begin() + y + 1, _rowMap.begin() + top);
+        _rowMap[y] = removal.slot;
+        for (size_t r = top; r <= y; ++r) {
+            _rowOf[_rowMap[r]] = (uint32_t)r;
+        }
+        _top = top;
+    }
+    std::copy_n(cells, _width, row(y));
+    uint32_t fill = (uint32_t)(_width - std::count(cells, cells + _width, (unsigned char)NO_BLOCK));
+    setFill(removal.slot, fill);
+    if (fill > 0) _top = std::min(_top, y);
+}
+
+void Board::raise(size_t rows, size_t hole, unsigned char color) {
+    if (rows > _height) rows = _height;
+    // the top rows are recycled as the new bottom rows
+    std::rotate(_rowMap.begin(), _rowMap.begin() + rows, _rowMap.end());
+    for (size_t y = 0; y < _height; ++y) {
+        _rowOf[_rowMap[y]] = (uint32_t)y;
+    }
+    _top = _top > rows ? _top - rows : 0;
+    for (size_t y = _height - rows; y < _height; ++y) {
+        fillRow(y, color);
+        set(hole % _width, y, NO_BLOCK);
+    }
+}
+
+void Board::clear() {
+    for (std::vector<unsigned char>& chunk : _chunks) {
+        std::fill(chunk.begin(), chunk.end(), NO_BLOCK);
+    }
+    std::fill(_fill.begin(), _fill.end(), 0);
+    _full.clear();
+    _top = _height;
+}
+
+uint32_t Board::checksum() const {
+    uint32_t hash = 2166136261u;
+    for (size_t y = 0; y < _height; ++y) {
+        const unsigned char* cells = row(y);
+        for (size_t x = 0; x < _width; ++x) {
+            hash = (hash ^ cells[x]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+void Board::copyFrom(const Board& other) {
+    if (other._width != _width || other._height != _height) {
+        throw std::invalid_argument("board sizes differ");
+    }
+    for (size_t c = 0; c < _chunks.size(); ++c) {
+        std::copy(other._chunks[c].begin(), other._chunks[c].end(), _chunks[c].begin());
+    }
+    std::copy(other._rowMap.begin(), other._rowMap.end(), _rowMap.begin());
+    std::copy(other._rowOf.begin(), other._rowOf.end(), _rowOf.begin());
+    std::copy(other._fill.begin(), other._fill.end(), _fill.begin());
+    _full.assign(other._full.begin(), other._full.end());
+    _top = other._top;
+}
+
+#endif
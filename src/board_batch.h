@@ -0,0 +1,65 @@
+#ifndef BOARD_BATCH_H
+#define BOARD_BATCH_H
+#include "grid.h"
+
+// collects quads for any number of boards and draws them in a single call,
+// using the shared block texture as the atlas
+class BoardBatch {
+   private:
+    // rebuilt every frame, keeps its capacity between frames
+    sf::VertexArray vertices;
+
+    void appendQuad(const sf::FloatRect& rect, const sf::Color& color, const sf::FloatRect& tex);
+
+   public:
+    BoardBatch() : vertices(sf::Quads) {}
+
+    void clear() { vertices.clear(); }
+    // adds the background, locked blocks and active piece of grid with its top left corner at rect
+    void addGrid(const GameGrid& grid, const sf::FloatRect& rect, float cell);
+    void draw(sf::RenderTarget& target) const { target.draw(vertices, sf::RenderStates(&Block::sharedTexture())); }
+};
+
+void BoardBatch::appendQuad(const sf::FloatRect& rect, const sf::Color& color, const sf::FloatRect& tex) {
+    float right = rect.left + rect.width, bottom = rect.top + rect.height;
+    vertices.append(sf::Vertex(sf::Vector2f(rect.left, rect.top), color, sf::Vector2f(tex.left, tex.top)));
+    vertices.append(sf::Vertex(sf::Vector2f(right, rect.top), color, sf::Vector2f(tex.left + tex.width, tex.top)));
+    vertices.append(sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(tex.left + tex.width, tex.top + tex.height)));
+    vertices.append(sf::Vertex(sf::Vector2f(rect.left, bottom), color, sf::Vector2f(tex.left, tex.top + tex.height)));
+}
+
+void BoardBatch::addGrid(const GameGrid& grid, const sf::FloatRect& rect, float cell) {
+    sf::Vector2u  texSize = Block::sharedTexture().getSize();
+    sf::FloatRect blockTex(0, 0, (float)texSize.x, (float)texSize.y);
+    // a single texel from the middle of the block, tinted, gives a flat background
+    sf::FloatRect flatTex(texSize.x / 2.f, texSize.y / 2.f, 0, 0);
+    appendQuad(rect, sf::Color(40, 42, 43), flatTex);
+
+    const Board& board = grid.getBoard();
+    for (size_t y = board.top(); y < board.height(); ++y) {
+        if (board.rowEmpty(y)) continue;
+        for (size_t x = 0; x < board.width(); ++x) {
+            unsigned char code = board.get(x, y);
+            if (code != NO_BLOCK) {
+                appendQuad(sf::FloatRect(rect.left + x * cell, rect.top + y * cell, cell, cell), blockColor(code), blockTex);
+            }
+        }
+    }
+
+    const Piece* piece = grid.getActivePiece();
+    if (piece) {
+        Block***  structure = piece->getStructure();
+        sf::Color color = blockColor(blockColorCode(piece->getColor()));
+        for (size_t px = 0; px < piece->getSize(); ++px) {
+            for (size_t py = 0; py < piece->getSize(); ++py) {
+                Block* block = structure[px][py];
+                if (block != nullptr && block->GetYPos() < board.height()) {
+                    appendQuad(sf::FloatRect(rect.left + block->GetXPos() * cell, rect.top + block->GetYPos() * cell, cell, cell), color,
+                               blockTex);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef BOT_H
+#define BOT_H
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "grid.h"
+
+// a piece cell in absolute grid coords, y can be negative while the piece is above the board
+struct Cell {
+    int x, y;
+};
+
+// a target for the active piece: extra rotations, then columns to shift (negative is left), then drop
+struct Placement {
+    unsigned rotations;
+    int      shift;
+    double   score;
+    bool     valid;
+};
+
+// where a piece came to rest, origin in grid coords and rotation stage
+struct Landing {
+    int            x, y;
+    unsigned short rotation;
+};
+
+// footprint of the piece after `rotations` more Rotate() calls, follows the same
+// transpose / anti-transpose steps as Piece::Rotate. writes up to size*size cells, returns the count
+size_t pieceFootprint(const Piece& piece, unsigned rotations, Cell* out);
+
+// plays the active piece of a GameGrid with a simple board evaluation
+// (aggregate height, holes, bumpiness and cleared lines)
+class Bot {
+   private:
+    // scratch board and column heights for evaluating placements, reused so choosing never allocates
+    Board               scratch;
+    std::vector<size_t> heights;
+    // copy of the position being decided, moved with the grid's own collision checks to find
+    // which placements the piece can actually reach
+    std::unique_ptr<GameGrid> probe;
+    GameState                 probeState;
+
+    double evaluate(const Board& board, size_t linesCleared);
+    // puts the probe back to probeState and performs `rotations` with rotatePiece, then finds how
+    // far the piece can slide each way from there. false if a rotation is blocked
+    bool reachable(unsigned rotations, int& minShift, int& maxShift);
+
+   public:
+    Bot(size_t width, size_t height)
+        : scratch(width, height), heights(width), probe(new GameGrid(width, height, 0)), probeState(width, height) {}
+
+    // best reachable placement for the grid's active piece, valid is false if nothing fits
+    Placement choose(const GameGrid& grid);
+};
+
+// performs `rotations` with the grid's collision checks, false if one of them stays blocked
+bool rotatePiece(GameGrid& grid, unsigned rotations);
+// performs a placement at once, checked like player input: rotatePiece, shifts, then a hard drop
+// landing is where the piece locked. false, with the piece left unlocked where it got stuck, if a
+// rotation or shift is blocked or there are more than 3 rotations
+bool applyPlacement(GameGrid& grid, const Placement& placement, Landing& landing);
+
+// drives a GameGrid one input per tick towards the bot's chosen placement, used for watched games
+// and as the opponent in versus
+class BotPlayer {
+   private:
+    Bot       bot;
+    Placement plan;
+    // piece count the plan was made for
+    size_t   planFor;
+    unsigned rotationsDone;
+    int      shiftDone;
+    // gravity pulls the piece down once every gravityTicks ticks
+    unsigned gravityTicks, ticks;
+
+   public:
+    BotPlayer(size_t width, size_t height, unsigned gravity = 8)
+        : bot(width, height), plan{0, 0, 0, false}, planFor(0), rotationsDone(0), shiftDone(0), gravityTicks(gravity), ticks(0) {}
+
+    // next InputBits towards the current plan, 0 once the piece is in place
+    unsigned char decide(const GameGrid& grid);
+    // advances the game by one tick, restarts it when it is over
+    void tick(GameGrid& grid);
+};
+
+size_t pieceFootprint(const Piece& piece, unsigned rotations, Cell* out) {
+    Block***       structure = piece.getStructure();
+    size_t         size = piece.getSize();
+    unsigned short stage = piece.getRotationStage();
+    size_t         count = 0;
+
+    for (size_t x = 0; x < size; ++x) {
+        for (size_t y = 0; y < size; ++y) {
+            if (structure[x][y] != nullptr) {
+                out[count].x = (int)x;
+                out[count].y = (int)y;
+                ++count;
+            }
+        }
+    }
+    for (unsigned r = 0; r < rotations; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            int x = out[i].x;
+            int y = out[i].y;
+            if (stage == 1 || stage == 3) {
+                out[i].x = y;
+                out[i].y = x;
+            } else {
+                out[i].x = (int)size - 1 - y;
+                out[i].y = (int)size - 1 - x;
+            }
+        }
+        stage = stage % 4 + 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out[i].x += piece.getOriginX();
+        out[i].y += piece.getOriginY();
+    }
+    return count;
+}
+
+double Bot::evaluate(const Board& board, size_t linesCleared) {
+    size_t width = board.width();
+    size_t height = board.height();
+    double aggregate = 0, holes = 0, bumpiness = 0;
+    // row by row from the highest occupied one, empty rows are skipped by their fill count
+    size_t started = 0;
+    std::fill(heights.begin(), heights.end(), 0);
+    for (size_t y = board.top(); y < height; ++y) {
+        if (board.rowEmpty(y)) {
+            holes += started;
+            continue;
+        }
+        for (size_t x = 0; x < width; ++x) {
+            if (board.isBlock(x, y)) {
+                if (heights[x] == 0) {
+                    heights[x] = height - y;
+                    ++started;
+                }
+            } else if (heights[x] != 0) {
+                ++holes;
+            }
+        }
+    }
+    for (size_t x = 0; x < width; ++x) {
+        aggregate += heights[x];
+        if (x > 0) bumpiness += heights[x] > heights[x - 1] ? heights[x] - heights[x - 1] : heights[x - 1] - heights[x];
+    }
+    return -0.51 * aggregate + 0.76 * linesCleared - 0.36 * holes - 0.18 * bumpiness;
+}
+
+Placement Bot::choose(const GameGrid& grid) {
+    Placement best = {0, 0, -std::numeric_limits<double>::infinity(), false};
+    const Piece* piece = grid.getActivePiece();
+    if (!piece) return best;
+
+    const Board& board = grid.getBoard();
+    int          height = (int)board.height();
+    Cell         cells[16];
+
+    grid.save(probeState);
+    for (unsigned rotations = 0; rotations < 4; ++rotations) {
+        int minShift, maxShift;
+        if (!reachable(rotations, minShift, maxShift)) continue;
+        size_t count = pieceFootprint(*piece, rotations, cells);
+        for (int shift = minShift; shift <= maxShift; ++shift) {
+            // lowest drop distance that still fits
+            int drop = -1;
+            for (int d = 0;; ++d) {
+                bool fits = true;
+                for (size_t i = 0; i < count && fits; ++i) {
+                    int x = cells[i].x + shift;
+                    int y = cells[i].y + d;
+                    if (y >= height || (y >= 0 && board.isBlock(x, y))) fits = false;
+                }
+                if (!fits) break;
+                drop = d;
+            }
+            if (drop < 0) continue;
+
+            bool aboveBoard = false;
+            scratch.copyFrom(board);
+            for (size_t i = 0; i < count; ++i) {
+                int y = cells[i].y + drop;
+                if (y < 0) {
+                    aboveBoard = true;
+                } else {
+                    scratch.set(cells[i].x + shift, y, WHITE_BLOCK);
+                }
+            }
+            if (aboveBoard) continue;
+            size_t lines = 0;
+            while (scratch.fullRows() > 0) {
+                scratch.removeRow(scratch.lowestFullRow());
+                ++lines;
+            }
+            double score = evaluate(scratch, lines);
+            if (score > best.score) {
+                best = {rotations, shift, score, true};
+            }
+        }
+    }
+    return best;
+}
+
+bool Bot::reachable(unsigned rotations, int& minShift, int& maxShift) {
+    probe->restore(probeState);
+    if (!rotatePiece(*probe, rotations)) return false;
+    // sliding is reversible within a row, so the range from the left wall covers the start too
+    minShift = 0;
+    while (probe->pieceCanMoveLeft()) {
+        probe->pieceLeft();
+        --minShift;
+    }
+    maxShift = minShift;
+    while (probe->pieceCanMoveRight()) {
+        probe->pieceRight();
+        ++maxShift;
+    }
+    return true;
+}
+
+unsigned char BotPlayer::decide(const GameGrid& grid) {
+    if (!grid.getActivePiece()) return 0;
+    if (grid.getPieceCount() != planFor) {
+        plan = bot.choose(grid);
+        planFor = grid.getPieceCount();
+        rotationsDone = 0;
+        shiftDone = 0;
+    }
+    if (!plan.valid) return 0;
+
+    if (rotationsDone < plan.rotations) {
+        // one tick of rotatePiece
+        if (!grid.pieceCanRotate()) return INPUT_DOWN;
+        ++rotationsDone;
+        return INPUT_ROTATE;
+    }
+    if (shiftDone < plan.shift) {
+        ++shiftDone;
+        return INPUT_RIGHT;
+    }
+    if (shiftDone > plan.shift) {
+        --shiftDone;
+        return INPUT_LEFT;
+    }
+    return 0;
+}
+
+bool rotatePiece(GameGrid& grid, unsigned rotations) {
+    for (unsigned r = 0; r < rotations; ++r) {
+        // pieces can't rotate while poking out of the top, let them fall in first
+        while (!grid.pieceCanRotate() && grid.pieceCanMoveDown()) {
+            grid.pieceDown();
+        }
+        if (!grid.pieceCanRotate()) return false;
+        grid.pieceRotate();
+    }
+    return true;
+}
+
+bool applyPlacement(GameGrid& grid, const Placement& placement, Landing& landing) {
+    if (placement.rotations > 3 || !rotatePiece(grid, placement.rotations)) return false;
+    for (int s = 0; s < placement.shift; ++s) {
+        if (!grid.pieceCanMoveRight()) return false;
+        grid.pieceRight();
+    }
+    for (int s = 0; s > placement.shift; --s) {
+        if (!grid.pieceCanMoveLeft()) return false;
+        grid.pieceLeft();
+    }
+    while (grid.pieceCanMoveDown()) {
+        grid.pieceDown();
+    }
+    const Piece* piece = grid.getActivePiece();
+    landing = {piece->getOriginX(), piece->getOriginY(), piece->getRotationStage()};
+    // can't move down any more, so this locks
+    grid.pieceDown();
+    return true;
+}
+
+void BotPlayer::tick(GameGrid& grid) {
+    if (grid.checkForGameOver()) {
+        grid.reset();
+    }
+    unsigned char input = decide(grid);
+    if (input != 0) {
+        grid.applyInput(input);
+    } else if (++ticks >= gravityTicks) {
+        ticks = 0;
+        grid.pieceDown();
+    }
+}
+
+#endif
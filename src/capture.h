@@ -0,0 +1,286 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SFML/OpenGL.hpp>
+
+#include "grid.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+enum class CaptureFormat { Png, Raw };
+
+// the buffer object calls used for asynchronous readback, GL 2.1 but missing from some platform
+// headers, so they are looked up through the SFML context
+struct PixelBufferFunctions {
+    void(APIENTRY* genBuffers)(GLsizei, GLuint*);
+    void(APIENTRY* deleteBuffers)(GLsizei, const GLuint*);
+    void(APIENTRY* bindBuffer)(GLenum, GLuint);
+    void(APIENTRY* bufferData)(GLenum, std::ptrdiff_t, const void*, GLenum);
+    void*(APIENTRY* mapBuffer)(GLenum, GLenum);
+    GLboolean(APIENTRY* unmapBuffer)(GLenum);
+
+    // needs an active context, false if the driver lacks any of them
+    bool load();
+};
+
+bool PixelBufferFunctions::load() {
+    genBuffers = reinterpret_cast<decltype(genBuffers)>(sf::Context::getFunction("glGenBuffers"));
+    deleteBuffers = reinterpret_cast<decltype(deleteBuffers)>(sf::Context::getFunction("glDeleteBuffers"));
+    bindBuffer = reinterpret_cast<decltype(bindBuffer)>(sf::Context::getFunction("glBindBuffer"));
+    bufferData = reinterpret_cast<decltype(bufferData)>(sf::Context::getFunction("glBufferData"));
+    mapBuffer = reinterpret_cast<decltype(mapBuffer)>(sf::Context::getFunction("glMapBuffer"));
+    unmapBuffer = reinterpret_cast<decltype(unmapBuffer)>(sf::Context::getFunction("glUnmapBuffer"));
+    return genBuffers && deleteBuffers && bindBuffer && bufferData && mapBuffer && unmapBuffer;
+}
+
+// records gameplay as an image sequence without slowing the game thread down
+// each frame the grid is drawn to an offscreen texture and glReadPixels copies it into a pixel
+// buffer object, the GPU finishes the transfer while the game carries on and a later frame copies
+// the pixels into a free buffer from a fixed pool. encoder threads compress and write it and hand
+// the buffer back. without buffer objects the pixels are read straight into the pool buffer.
+// when every buffer is still in flight the frame is dropped and counted, the game never waits
+class FrameCapture {
+   private:
+    struct Job {
+        uint64_t frame;
+        size_t   buffer;
+    };
+    // a frame on its way back from the GPU
+    struct Readback {
+        GLuint   pbo;
+        uint64_t frame;
+        bool     pending;
+    };
+
+    std::string      directory;
+    CaptureFormat    format;
+    sf::RenderTexture target;
+    unsigned int     width, height;
+
+    PixelBufferFunctions  gl;
+    std::vector<Readback> readbacks;
+    // readback the next frame goes into, the oldest one in flight
+    size_t nextReadback;
+
+    std::vector<std::vector<sf::Uint8>> pool;
+    std::vector<size_t>                 freeBuffers;
+    std::vector<Job>                    jobs;
+    std::mutex                          mutex;
+    std::condition_variable             jobReady;
+    std::vector<std::thread>            encoders;
+    bool                                stopping;
+
+    // stats
+    uint64_t frames, captured, dropped, written, failed;
+
+    // takes a buffer from the pool, false (and the frame counts as dropped) when all are in flight
+    bool takeBuffer(size_t& buffer);
+    void queue(uint64_t frame, size_t buffer);
+    // copies a finished readback into a pool buffer and queues it
+    void collect(Readback& readback);
+    void encode();
+    bool write(const Job& job, const std::vector<sf::Uint8>& pixels) const;
+
+   public:
+    // scale shrinks the board (BLOCK_SIZE per cell) to keep encoding cheap
+    // readbacks is the number of frames allowed in flight on the GPU, 0 reads back synchronously
+    FrameCapture(const std::string& directory, CaptureFormat format = CaptureFormat::Png, float scale = 0.5f, size_t encoderThreads = 2,
+                 size_t poolSize = 8, size_t readbacks = 2);
+    ~FrameCapture() { finish(); }
+
+    // collects the frames still on the GPU, waits for queued frames to be written and stops the encoders
+    void finish();
+
+    // renders and queues one frame, called once per game frame
+    void captureFrame(const GameGrid& grid);
+    void report(std::ostream& os) const;
+};
+
+FrameCapture::FrameCapture(const std::string& dir, CaptureFormat fmt, float scale, size_t encoderThreads, size_t poolSize, size_t readbackCount)
+    : directory(dir), format(fmt), nextReadback(0), stopping(false), frames(0), captured(0), dropped(0), written(0), failed(0) {
+    std::filesystem::create_directories(directory);
+    width = (unsigned int)(WIDTH * BLOCK_SIZE * scale);
+    height = (unsigned int)(HEIGHT * BLOCK_SIZE * scale);
+    if (!target.create(width, height)) {
+        throw std::runtime_error("can't create capture texture");
+    }
+    // draw the board in its usual coordinates, the view does the scaling
+    target.setView(sf::View(sf::FloatRect(0, 0, (float)(WIDTH * BLOCK_SIZE), (float)(HEIGHT * BLOCK_SIZE))));
+
+    pool.assign(poolSize < 1 ? 1 : poolSize, std::vector<sf::Uint8>((size_t)width * height * 4));
+    if (readbackCount > 0 && target.setActive() && gl.load()) {
+        readbacks.assign(readbackCount, Readback{0, 0, false});
+        for (Readback& readback : readbacks) {
+            gl.genBuffers(1, &readback.pbo);
+            gl.bindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+            gl.bufferData(GL_PIXEL_PACK_BUFFER, (std::ptrdiff_t)pool[0].size(), nullptr, GL_STREAM_READ);
+        }
+        gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    for (size_t i = 0; i < pool.size(); ++i) {
+        freeBuffers.push_back(i);
+    }
+    jobs.reserve(pool.size());
+    if (encoderThreads == 0) encoderThreads = 1;
+    for (size_t i = 0; i < encoderThreads; ++i) {
+        encoders.emplace_back(&FrameCapture::encode, this);
+    }
+}
+
+void FrameCapture::finish() {
+    if (!readbacks.empty() && target.setActive()) {
+        for (size_t i = 0; i < readbacks.size(); ++i) {
+            Readback& readback = readbacks[(nextReadback + i) % readbacks.size()];
+            if (readback.pending) collect(readback);
+            gl.deleteBuffers(1, &readback.pbo);
+        }
+    }
+    readbacks.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& encoder : encoders) {
+        if (encoder.joinable()) encoder.join();
+    }
+}
+
+bool FrameCapture::takeBuffer(size_t& buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeBuffers.empty()) {
+        ++dropped;
+        return false;
+    }
+    buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return true;
+}
+
+void FrameCapture::queue(uint64_t frame, size_t buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({frame, buffer});
+        ++captured;
+    }
+    jobReady.notify_one();
+}
+
+void FrameCapture::collect(Readback& readback) {
+    readback.pending = false;
+    size_t buffer;
+    if (!takeBuffer(buffer)) return;
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const void* pixels = gl.mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels) {
+        std::memcpy(pool[buffer].data(), pixels, pool[buffer].size());
+        gl.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!pixels) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++failed;
+        freeBuffers.push_back(buffer);
+        return;
+    }
+    queue(readback.frame, buffer);
+}
+
+void FrameCapture::captureFrame(const GameGrid& grid) {
+    uint64_t frame = frames++;
+    size_t   buffer = 0;
+    // without buffer objects the pool buffer is needed right away, skip drawing if there is none
+    if (readbacks.empty() && !takeBuffer(buffer)) return;
+
+    target.clear(sf::Color(82, 86, 87, 56));
+    grid.drawGrid(target);
+    target.display();
+    target.setActive();
+    // rows come back bottom-up, the encoders flip them
+    if (readbacks.empty()) {
+        // waits for the GPU, compression and disk writes stay on the encoders
+        glReadPixels(0, 0, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, pool[buffer].data());
+        queue(frame, buffer);
+        return;
+    }
+    // the oldest readback was issued readbacks.size() frames ago and is normally done by now
+    Readback& readback = readbacks[nextReadback];
+    if (readback.pending) collect(readback);
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glReadPixels(0, 0, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.frame = frame;
+    readback.pending = true;
+    nextReadback = (nextReadback + 1) % readbacks.size();
+}
+
+void FrameCapture::encode() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = jobs.front();
+            jobs.erase(jobs.begin());
+        }
+        bool ok = write(job, pool[job.buffer]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                ++written;
+            } else {
+                ++failed;
+            }
+            freeBuffers.push_back(job.buffer);
+        }
+    }
+}
+
+bool FrameCapture::write(const Job& job, const std::vector<sf::Uint8>& pixels) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06llu.%s", (unsigned long long)job.frame, format == CaptureFormat::Png ? "png" : "rgba");
+    std::string path = directory + "/" + name;
+    if (format == CaptureFormat::Png) {
+        sf::Image image;
+        image.create(width, height, pixels.data());
+        image.flipVertically();
+        return image.saveToFile(path);
+    }
+    FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) return false;
+    // top row first like the png
+    size_t stride = (size_t)width * 4;
+    bool   ok = true;
+    for (size_t y = height; ok && y-- > 0;) {
+        ok = std::fwrite(pixels.data() + y * stride, 1, stride, out) == stride;
+    }
+    return std::fclose(out) == 0 && ok;
+}
+
+void FrameCapture::report(std::ostream& os) const {
+    os << "Capture: " << frames << " frames, " << captured << " captured, " << written << " written to " << directory << ", "
+       << dropped << " dropped (encoders behind), " << failed << " failed" << std::endl;
+}
+
+#endif
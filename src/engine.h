@@ -0,0 +1,416 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "bot.h"
+
+// Headless engine server for external bots, one line per message over a pair of file descriptors
+// (stdin/stdout, or pipes for the built-in stand-in). The engine ends lines with "\n", lines from the
+// bot may end with "\n" or "\r\n".
+//
+// engine -> bot
+//   game <index> <width> <height> <budget ms>
+//   state <move> <score> <piece> <x> <y> <rotation> <next>   piece and next are PieceKind values,
+//                          x y is the signed origin of the piece, -1 for pieces that spawn with an empty top row
+//   board <first> <rows>   rows from `first` down, '/' separated, '#' occupied '.' empty, rows above are empty
+//   go                     the bot has <budget ms> to reply
+//   end <score> <moves> <topout|limit|illegal|timeout|closed>
+//   quit
+// bot -> engine, one reply per go
+//   place <rotations> <shift>   extra rotations, columns to shift (negative is left), then a hard drop
+//   inputs <keys>               L R C(rotate) D(down) H(hard drop), hard dropped afterwards if still falling
+// a rotation or shift that the grid's collision checks block is illegal, for both reply forms
+// an illegal reply loses the game, a missed budget or a closed pipe ends the session
+
+enum class ReadResult { Line, Timeout, Closed };
+
+// buffered line reader on a raw descriptor, poll() enforces the deadline
+class LineReader {
+   private:
+    int         fd;
+    std::string buffer;
+    size_t      start;
+
+   public:
+    LineReader(int fd) : fd(fd), start(0) { buffer.reserve(1 << 16); }
+
+    // next line without its "\n" or "\r\n", waits at most timeoutMs (negative waits forever)
+    ReadResult readLine(std::string& line, int timeoutMs);
+};
+
+// fixed-size histogram of latencies in microseconds, memory doesn't grow with the number of samples
+// buckets are log scale with 8 per doubling, so percentiles come out within 12.5% (below 1 us all
+// land in the first bucket)
+class LatencyHistogram {
+   private:
+    static const size_t SUB_BUCKETS = 8;
+    // covers up to 2^40 us
+    static const size_t BUCKETS = 1 + 40 * SUB_BUCKETS;
+
+    uint64_t counts[BUCKETS];
+    uint64_t samples;
+    double   sum, worst;
+
+    static size_t bucket(double us);
+    // every sample in the bucket is below this
+    static double bound(size_t bucket);
+
+   public:
+    LatencyHistogram() : counts{}, samples(0), sum(0), worst(0) {}
+
+    void add(double us);
+    uint64_t count() const { return samples; }
+    double average() const { return samples ? sum / samples : 0; }
+    double max() const { return worst; }
+    // upper bound of the bucket holding the given fraction of samples, capped at the worst sample
+    double percentile(double fraction) const;
+};
+
+// writes all of text, false if the other end is gone
+bool writeAll(int fd, const std::string& text);
+
+// plays games against one external bot and measures it
+class EngineServer {
+   private:
+    LineReader  reader;
+    int         outFd;
+    size_t      width, height;
+    int         budgetMs;
+    size_t      maxMoves;
+    // reused for every message so the move loop does not allocate
+    std::string message, line;
+
+    // stats
+    size_t           games, moves, illegal, timeouts, bytesIn, bytesOut;
+    uint64_t         totalScore;
+    LatencyHistogram rtts;
+    double           validationMicroseconds;
+
+    void appendState(const GameGrid& grid, size_t move);
+    // checks a reply against the grid's move and collision rules and plays it, false if illegal
+    bool applyReply(GameGrid& grid, const std::string& reply);
+    bool applyInputs(GameGrid& grid, const char* keys);
+
+   public:
+    EngineServer(int inFd, int outFd, size_t width, size_t height, int budgetMs, size_t maxMoves = 1000);
+
+    // plays up to `games` games, stops early when the bot times out or disconnects
+    void run(size_t games, unsigned int seed);
+    void report(std::ostream& os) const;
+};
+
+// serves `games` games on stdin/stdout, the report goes to stderr
+void runEngineServer(size_t games, int budgetMs);
+// serves `games` games to the built-in bot over a pair of pipes
+void runEngineSelfTest(size_t games, int budgetMs);
+
+ReadResult LineReader::readLine(std::string& line, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true) {
+        size_t end = buffer.find('\n', start);
+        if (end != std::string::npos) {
+            line.assign(buffer, start, end - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            start = end + 1;
+            if (start == buffer.size()) {
+                buffer.clear();
+                start = 0;
+            }
+            return ReadResult::Line;
+        }
+        // drop consumed bytes before reading more
+        buffer.erase(0, start);
+        start = 0;
+
+        int wait = -1;
+        if (timeoutMs >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return ReadResult::Timeout;
+            wait = (int)left;
+        }
+        pollfd request = {fd, POLLIN, 0};
+        int    ready = poll(&request, 1, wait);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) return ReadResult::Closed;
+        if (ready == 0) return ReadResult::Timeout;
+
+        char    chunk[4096];
+        ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return ReadResult::Closed;
+        buffer.append(chunk, count);
+    }
+}
+
+size_t LatencyHistogram::bucket(double us) {
+    if (us < 1) return 0;
+    int    exponent;
+    double mantissa = std::frexp(us, &exponent);  // us = mantissa * 2^exponent, mantissa in [0.5, 1)
+    size_t index = 1 + (size_t)(exponent - 1) * SUB_BUCKETS + (size_t)((mantissa * 2 - 1) * SUB_BUCKETS);
+    return std::min(index, BUCKETS - 1);
+}
+
+double LatencyHistogram::bound(size_t bucket) {
+    if (bucket == 0) return 1;
+    size_t doubling = (bucket - 1) / SUB_BUCKETS, sub = (bucket - 1) % SUB_BUCKETS;
+    return std::ldexp(1 + (double)(sub + 1) / SUB_BUCKETS, (int)doubling);
+}
+
+void LatencyHistogram::add(double us) {
+    ++counts[bucket(us)];
+    ++samples;
+    sum += us;
+    worst = std::max(worst, us);
+}
+
+double LatencyHistogram::percentile(double fraction) const {
+    uint64_t wanted = (uint64_t)std::ceil(fraction * samples), seen = 0;
+    if (wanted == 0) return 0;
+    for (size_t b = 0; b < BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen >= wanted) return std::min(bound(b), worst);
+    }
+    return worst;
+}
+
+bool writeAll(int fd, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t count = write(fd, text.data() + done, text.size() - done);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        done += count;
+    }
+    return true;
+}
+
+EngineServer::EngineServer(int inFd, int out, size_t w, size_t h, int budget, size_t limit)
+    : reader(inFd), outFd(out), width(w), height(h), budgetMs(budget), maxMoves(limit), games(0), moves(0), illegal(0), timeouts(0),
+      bytesIn(0), bytesOut(0), totalScore(0), validationMicroseconds(0) {
+    // a full board message plus the state line
+    message.reserve(height * (width + 1) + 128);
+}
+
+void EngineServer::appendState(const GameGrid& grid, size_t move) {
+    const Piece* piece = grid.getActivePiece();
+    const Board& board = grid.getBoard();
+    char         header[160];
+    std::snprintf(header, sizeof(header), "state %zu %zu %d %d %d %u %d\nboard %zu ", move, grid.getScore(), (int)grid.getActiveKind(),
+                  piece->getOriginX(), piece->getOriginY(), (unsigned)piece->getRotationStage(), (int)grid.getNextKind(), board.top());
+    message += header;
+    for (size_t y = board.top(); y < board.height(); ++y) {
+        if (y > board.top()) message += '/';
+        for (size_t x = 0; x < board.width(); ++x) {
+            message += board.isBlock(x, y) ? '#' : '.';
+        }
+    }
+    message += "\ngo\n";
+}
+
+bool EngineServer::applyInputs(GameGrid& grid, const char* keys) {
+    size_t piece = grid.getPieceCount();
+    // inputs after the piece locked would move the next one, they are ignored
+    for (const char* key = keys; *key && grid.getPieceCount() == piece; ++key) {
+        switch (*key) {
+            case 'L':
+                if (!grid.pieceCanMoveLeft()) return false;
+                grid.applyInput(INPUT_LEFT);
+                break;
+            case 'R':
+                if (!grid.pieceCanMoveRight()) return false;
+                grid.applyInput(INPUT_RIGHT);
+                break;
+            case 'C':
+                if (!grid.pieceCanRotate()) return false;
+                grid.applyInput(INPUT_ROTATE);
+                break;
+            case 'D':
+                grid.applyInput(INPUT_DOWN);
+                break;
+            case 'H':
+                grid.applyInput(INPUT_DROP);
+                break;
+            default:
+                return false;
+        }
+    }
+    if (grid.getPieceCount() == piece) grid.hardDrop();
+    return true;
+}
+
+bool EngineServer::applyReply(GameGrid& grid, const std::string& reply) {
+    unsigned rotations;
+    int      shift, used = 0;
+    if (std::sscanf(reply.c_str(), "place %u %d%n", &rotations, &shift, &used) == 2 && (size_t)used == reply.size()) {
+        Landing landing;
+        return applyPlacement(grid, Placement{rotations, shift, 0, true}, landing);
+    }
+    if (reply.compare(0, 7, "inputs ") == 0) {
+        return applyInputs(grid, reply.c_str() + 7);
+    }
+    return false;
+}
+
+void EngineServer::run(size_t count, unsigned int seed) {
+    GameGrid grid(width, height, 0);
+    char     text[96];
+    bool     connected = true;
+
+    for (size_t game = 0; game < count && connected; ++game) {
+        grid.seed(seed + (unsigned int)game);
+        grid.reset();
+        std::snprintf(text, sizeof(text), "game %zu %zu %zu %d\n", game, width, height, budgetMs);
+        message = text;
+
+        size_t      move = 0;
+        const char* reason = "limit";
+        while (move < maxMoves) {
+            if (grid.checkForGameOver()) {
+                reason = "topout";
+                break;
+            }
+            appendState(grid, move);
+            bytesOut += message.size();
+            auto sent = std::chrono::steady_clock::now();
+            if (!writeAll(outFd, message)) {
+                reason = "closed";
+                connected = false;
+                break;
+            }
+            message.clear();
+
+            ReadResult result = reader.readLine(line, budgetMs);
+            auto       received = std::chrono::steady_clock::now();
+            if (result == ReadResult::Timeout) {
+                ++timeouts;
+                reason = "timeout";
+                connected = false;
+                break;
+            }
+            if (result == ReadResult::Closed) {
+                reason = "closed";
+                connected = false;
+                break;
+            }
+            bytesIn += line.size() + 1;
+            rtts.add(std::chrono::duration<double, std::micro>(received - sent).count());
+
+            bool legal = applyReply(grid, line);
+            validationMicroseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - received).count();
+            if (!legal) {
+                ++illegal;
+                reason = "illegal";
+                break;
+            }
+            ++move;
+        }
+
+        ++games;
+        moves += move;
+        totalScore += grid.getScore();
+        std::snprintf(text, sizeof(text), "end %zu %zu %s\n", grid.getScore(), move, reason);
+        message += text;
+        if (!connected) message += "quit\n";
+        writeAll(outFd, message);
+        message.clear();
+    }
+    if (connected) writeAll(outFd, "quit\n");
+}
+
+void EngineServer::report(std::ostream& os) const {
+    os << "Engine: " << games << " games, " << moves << " moves, average score " << (games ? totalScore / games : 0) << ", " << illegal
+       << " illegal, " << timeouts << " timeouts" << std::endl;
+    os << "Round trip: " << rtts.average() << " us average / " << rtts.percentile(0.99) << " us p99 / " << rtts.max() << " us worst, " << bytesOut / 1024 << " KiB out, "
+       << bytesIn / 1024 << " KiB in" << std::endl;
+    os << "Validation: " << (moves ? validationMicroseconds / moves : 0) << " us per move, "
+       << (validationMicroseconds > 0 ? moves / (validationMicroseconds / 1e6) : 0) << " moves/s" << std::endl;
+}
+
+// the built-in bot: rebuilds the position from each message and answers with Bot's placement
+void runReferenceBot(int inFd, int outFd) {
+    LineReader                 reader(inFd);
+    std::string                line, reply;
+    std::unique_ptr<GameGrid>  grid;
+    std::unique_ptr<GameState> state;
+    std::unique_ptr<Bot>       bot;
+
+    while (reader.readLine(line, -1) == ReadResult::Line) {
+        size_t   index, width, height, move, score, first;
+        int      x, y, budget, kind, next;
+        unsigned rotation;
+        if (std::sscanf(line.c_str(), "game %zu %zu %zu %d", &index, &width, &height, &budget) == 4) {
+            grid.reset(new GameGrid(width, height, 0));
+            state.reset(new GameState(width, height));
+            bot.reset(new Bot(width, height));
+        } else if (state && std::sscanf(line.c_str(), "state %zu %zu %d %d %d %u %d", &move, &score, &kind, &x, &y, &rotation, &next) == 7) {
+            state->hasPiece = true;
+            state->kind = (unsigned char)kind;
+            state->color = WHITE_BLOCK;
+            state->x = x;
+            state->y = y;
+            state->rotation = (unsigned short)rotation;
+        } else if (state && std::sscanf(line.c_str(), "board %zu", &first) == 1) {
+            state->board.clear();
+            size_t row = first, column = 0;
+            for (size_t i = line.find(' ', 6) + 1; i < line.size(); ++i) {
+                if (line[i] == '/') {
+                    ++row;
+                    column = 0;
+                } else {
+                    if (line[i] == '#') state->board.set(column, row, WHITE_BLOCK);
+                    ++column;
+                }
+            }
+        } else if (grid && line == "go") {
+            grid->restore(*state);
+            Placement placement = bot->choose(*grid);
+            reply = "place " + std::to_string(placement.rotations) + " " + std::to_string(placement.shift) + "\n";
+            if (!writeAll(outFd, reply)) return;
+        } else if (line == "quit") {
+            return;
+        }
+    }
+}
+
+void runEngineServer(size_t games, int budgetMs) {
+    // a bot that exits early must not kill the engine
+    std::signal(SIGPIPE, SIG_IGN);
+    EngineServer server(STDIN_FILENO, STDOUT_FILENO, WIDTH, HEIGHT, budgetMs);
+    server.run(games, (unsigned int)time(0));
+    server.report(std::cerr);
+}
+
+void runEngineSelfTest(size_t games, int budgetMs) {
+    std::signal(SIGPIPE, SIG_IGN);
+    int toBot[2], toEngine[2];
+    if (pipe(toBot) != 0 || pipe(toEngine) != 0) {
+        std::cerr << "can't create pipes" << std::endl;
+        return;
+    }
+    std::thread bot([&] {
+        runReferenceBot(toBot[0], toEngine[1]);
+        close(toEngine[1]);
+    });
+
+    EngineServer server(toEngine[0], toBot[1], WIDTH, HEIGHT, budgetMs);
+    server.run(games, 1);
+    close(toBot[1]);
+    bot.join();
+    close(toBot[0]);
+    close(toEngine[0]);
+    server.report(std::cout);
+}
+
+#endif
@@ -1,49 +1,167 @@
 #ifndef GRID_H
 #define GRID_H
 #include <chrono>
+#include <random>
 #include <thread>
 
+#include "board.h"
 #include "pieces.h"
+#include "rewind.h"
+#include "telemetry.h"
 
 extern const size_t BLOCK_SIZE;
 extern const size_t WIDTH;
 extern const size_t HEIGHT;
-extern size_t       SCORE;
+
+// number of locks kept for rewinding
+const size_t REWIND_CAPACITY = 512;
+
+// one frame of player input, any combination may be pressed
+enum InputBits : unsigned char { INPUT_LEFT = 1, INPUT_RIGHT = 2, INPUT_ROTATE = 4, INPUT_DOWN = 8, INPUT_DROP = 16 };
+
+// everything that determines how a GameGrid plays out from here, see GameGrid::save / restore
+// the board is preallocated, so saving into an existing GameState never allocates
+struct GameState {
+    Board            board;
+    size_t           score, pieceCount, lastClear;
+    std::minstd_rand rng;
+    bool             hasPiece;
+    unsigned char    kind, color;
+    int              x, y;
+    unsigned short   rotation;
+
+    GameState(size_t width, size_t height)
+        : board(width, height), score(0), pieceCount(0), lastClear(0), hasPiece(false), kind(0), color(NO_BLOCK), x(0), y(0), rotation(1) {}
+
+    // hash of the board, score and active piece, equal states give equal checksums
+    uint32_t checksum() const;
+};
+
+uint32_t GameState::checksum() const {
+    uint32_t hash = board.checksum();
+    hash = (hash ^ (uint32_t)score) * 16777619u;
+    if (hasPiece) {
+        hash = (hash ^ kind) * 16777619u;
+        hash = (hash ^ (uint32_t)x) * 16777619u;
+        hash = (hash ^ (uint32_t)y) * 16777619u;
+        hash = (hash ^ rotation) * 16777619u;
+    }
+    return hash;
+}
 
 class GameGrid {
    private:
     // attributes
-    size_t   GridWidth, GridHeight, BlockSize;
-    Block*** _grid;
-    // pointer to active piece, only one allowed at a time
+    size_t GridWidth, GridHeight, BlockSize;
+    // locked blocks, stored by value
+    Board _board;
+    // one preallocated piece per PieceKind, spawning reuses them so locks never allocate
+    Piece* piecePool[PIECE_KINDS];
+    // pointer to active piece, one of piecePool or nullptr
     Piece* activePiece;
-
-    // creates 2D array filled with nullptrs
-    void initializeStructure();
-    // sets each block to its corresponding grid position
-    void mirrorBlocksToGrid() const;
+    PieceKind activeKind;
+    // what each of the last REWIND_CAPACITY locks changed, only covers locks since the last
+    // reset, restore or garbage since those change the board outside of a lock
+    RewindBuffer history;
+    size_t score;
+    // lines removed by the most recent lock
+    size_t lastClear;
+    // number of pieces spawned so far, lets controllers notice a new piece
+    size_t pieceCount;
+    // piece and color selection, one generator per grid so grids can run on separate threads
+    std::minstd_rand rng;
+    // single sprite moved around to draw every locked cell
+    mutable Block cellSprite;
 
     sf::RenderWindow* win;
+    // optional event sink, nullptr when telemetry is off
+    Telemetry* telemetry;
+
+    void record(TelemetryType type, int64_t value = 0) {
+        if (telemetry) telemetry->record(type, value);
+    }
+    void recordPiece(TelemetryType type) {
+        if (telemetry && activePiece)
+            telemetry->record(type, activePiece->getRotationStage(), activePiece->getOriginX(), activePiece->getOriginY(), activeKind);
+    }
+
+    // replaces the active piece without counting it as a spawn
+    void createPiece(PieceKind kind, const std::string& color);
+    // allocates a piece of the given kind, only used to fill piecePool
+    static Piece* newPiece(PieceKind kind);
+    // picks a random kind and color, the only place the generator is used for pieces
+    static PieceKind drawPiece(std::minstd_rand& gen, std::string& color);
 
    public:
-    GameGrid() : GridWidth(WIDTH), GridHeight(HEIGHT), BlockSize(BLOCK_SIZE) { initializeStructure(); }
+    // rewindCapacity 0 turns rewinding off, for simulations that never need it
+    GameGrid(size_t rewindCapacity = REWIND_CAPACITY) : GameGrid(WIDTH, HEIGHT, rewindCapacity) {}
+    // a board of any size in blocks, e.g. very tall stress boards, rewind memory only depends on the width
+    GameGrid(size_t width, size_t height, size_t rewindCapacity = REWIND_CAPACITY)
+        : GridWidth(width), GridHeight(height), BlockSize(BLOCK_SIZE), _board(width, height), activePiece(nullptr),
+          activeKind(Z_PIECE), history(rewindCapacity, width), score(0), lastClear(0), pieceCount(0),
+          cellSprite("white"), win(nullptr), telemetry(nullptr) {
+        for (size_t kind = 0; kind < PIECE_KINDS; ++kind) {
+            piecePool[kind] = newPiece((PieceKind)kind);
+        }
+    }
     ~GameGrid();
+    // owns its pieces, use save / restore to copy a position
+    GameGrid(const GameGrid&) = delete;
+    GameGrid& operator=(const GameGrid&) = delete;
 
+    // without a window the grid runs headless: no line flash and no pause after a lock
     void setWindow(sf::RenderWindow& window) { win = &window; }
+    void setTelemetry(Telemetry& sink) { telemetry = &sink; }
+    void seed(unsigned int value) { rng.seed(value); }
+
+    size_t getScore() const { return score; }
+    size_t getPieceCount() const { return pieceCount; }
+    size_t getLastClear() const { return lastClear; }
+    size_t getWidth() const { return GridWidth; }
+    size_t getHeight() const { return GridHeight; }
+    const Piece* getActivePiece() const { return activePiece; }
+    PieceKind getActiveKind() const { return activeKind; }
+    // the kind spawnNewPiece will produce next, without consuming it
+    PieceKind getNextKind() const;
+
+    // empties the board, zeroes the score and spawns a fresh piece
+    void reset();
+
+    // copies the complete simulation state, board, score, generator and active piece
+    void save(GameState& state) const;
+    // puts the grid back into a saved state, reuses the active piece when kind and color match
+    void restore(const GameState& state);
+
+    // applies one frame of InputBits, in the order rotate, left, right, down, drop
+    void applyInput(unsigned char input);
+    // adds garbage rows at the bottom with one empty column
+    void addGarbage(size_t rows, size_t hole) {
+        _board.raise(rows, hole, BLACK_BLOCK);
+        history.reset();
+    }
 
-    // deletes old piece and spawns a new one
-    // note: piece virtual destructor should not delete the Block* inside of it since they will be
-    // transfered to the GameGrid,
+    // replaces the active piece with a new random one
     void spawnNewPiece();
+    // replaces the active piece with the given kind, an empty color means random
+    void spawnPiece(PieceKind kind, const std::string& color = "");
 
-    // draws the grid and the piece
-    void drawGrid() const;
+    // draws the grid and the piece to the window
+    void drawGrid() const { drawGrid(*win); }
+    // draws the grid and the piece to any target, e.g. an offscreen texture
+    void drawGrid(sf::RenderTarget& target) const;
 
-    // transfers ownership of block* from piece to grid
+    // copies the piece's cells into the board as color codes, the piece goes back to the pool
     void movePieceToGrid();
 
-    // returns true if specified coordinate is occupied by a Block object
-    bool isBlock(int x, int y) const { return _grid[x][y]; }
+    // returns true if specified coordinate is occupied by a locked block
+    bool isBlock(int x, int y) const { return _board.isBlock(x, y); }
+    const Board& getBoard() const { return _board; }
+
+    // number of locks that can currently be undone
+    size_t rewindDepth() const { return history.size(); }
+    // restores the board and score from `steps` locks ago and respawns the piece that locked then
+    // returns false if there is not enough history
+    bool rewind(size_t steps = 1);
 
     // checks the grid for any filled lines, returns y value of filled grid. else returns -1
     // checks from bottom up
@@ -69,147 +187,111 @@ class GameGrid {
     void pieceRight();
     void pieceLeft();
     void pieceRotate();
+    // drops the piece as far as it goes and locks it
+    void hardDrop();
 };
 
-// PRIVATE
-void GameGrid::initializeStructure() {
-    _grid = new Block**[GridWidth];
-    for (size_t i = 0; i < GridWidth; ++i) {
-        _grid[i] = new Block*[GridHeight];
-    }
-
-    for (size_t i = 0; i < GridWidth; ++i) {
-        for (size_t j = 0; j < GridHeight; ++j) {
-            _grid[i][j] = nullptr;
-        }
-    }
-}
-
 // PUBLIC
 GameGrid::~GameGrid() {
-    if (activePiece) {
-        delete activePiece;
-    }
-
-    for (size_t i = 0; i < GridWidth; ++i) {
-        for (size_t j = 0; j < GridHeight; ++j) {
-            if (_grid[i][j] != nullptr) {
-                delete _grid[i][j];
-            }
-        }
-    }
-    for (size_t i = 0; i < GridWidth; ++i) {
-        delete[] _grid[i];
+    for (Piece* piece : piecePool) {
+        delete piece;
     }
-    delete[] _grid;
 }
 
 int GameGrid::checkForLine() {
-    bool LineFull;
-    for (size_t y = (HEIGHT - 1); y > 0; --y) {
-        LineFull = true;
-        for (size_t x = 0; x < WIDTH; ++x) {
-            if (!isBlock(x, y)) {
-                LineFull = false;
-            }
-        }
-        if (LineFull) return y;
-    }
-    return -1;
+    // the board indexes its full rows, the top row never counts as a line
+    int y = _board.lowestFullRow();
+    return y > 0 ? y : -1;
 }
 
 bool GameGrid::checkForGameOver() {
-    size_t xStart = (WIDTH / 2) - 2;
-    size_t xEnd = (WIDTH / 2) + 2;
+    size_t xStart = (GridWidth / 2) - 2;
+    size_t xEnd = (GridWidth / 2) + 2;
 
     for (size_t y = 0; y < 2; ++y) {
         for (size_t x = xStart; x < xEnd; ++x) {
-            if (_grid[x][y]) return true;
+            if (isBlock(x, y)) return true;
         }
     }
     return false;
 }
 
 void GameGrid::flashLine(int yLine) {
-    for (size_t x = 0; x < WIDTH; ++x) {
-        _grid[x][yLine]->setColor(sf::Color::White);
-    }
+    _board.fillRow(yLine, WHITE_BLOCK);
     win->clear(sf::Color(82, 86, 87, 56));
     drawGrid();
     win->display();
     std::this_thread::sleep_for(std::chrono::milliseconds(450));
-    for (size_t x = 0; x < WIDTH; ++x) {
-        _grid[x][yLine]->setColor(sf::Color::Transparent);
-    }
+    _board.fillRow(yLine, NO_BLOCK);
     win->clear(sf::Color(82, 86, 87, 56));
     drawGrid();
     win->display();
 }
 
 void GameGrid::clearLine(int yLine) {
-    flashLine(yLine);
-    for (size_t x = 0; x < WIDTH; ++x) {
-        if (_grid[x][yLine] != nullptr) {
-            delete _grid[x][yLine];
-            _grid[x][yLine] = nullptr;
-            SCORE += 10;
-        } else {
-            throw std::invalid_argument("trying to delete not-full line");
-        }
+    if (!_board.rowFull(yLine)) {
+        throw std::invalid_argument("trying to delete not-full line");
     }
+    if (win) flashLine(yLine);
+    _board.fillRow(yLine, NO_BLOCK);
+    score += 10 * GridWidth;
 }
 
 void GameGrid::moveBlocksDown(int yLine) {
-    for (size_t y = (size_t)(yLine - 1); y > 0; --y) {
-        for (size_t x = 0; x < WIDTH; ++x) {
-            if (_grid[x][y] != nullptr) {
-                std::swap(_grid[x][y], _grid[x][y + 1]);
-            }
-        }
-    }
+    _board.removeRow(yLine);
 }
 
 void GameGrid::removeFullLines() {
-    int yLine = checkForLine();
+    size_t scoreBefore = score;
+    int    lines = 0;
+    int    yLine = checkForLine();
     // std::cout << "Line " << yLine << " is full" << std::endl;
     while (yLine != -1) {
+        // rewind keeps the row before clearLine empties it
+        history.captureRow(_board, yLine);
         clearLine(yLine);
         moveBlocksDown(yLine);
+        ++lines;
         yLine = checkForLine();
     }
-    mirrorBlocksToGrid();
-    spawnNewPiece();
-}
-
-void GameGrid::mirrorBlocksToGrid() const {
-    for (size_t i = 0; i < GridWidth; ++i) {
-        for (size_t j = 0; j < GridHeight; ++j) {
-            if (_grid[i][j] != nullptr) {
-                _grid[i][j]->moveToGridPos(i, j);
-            }
-        }
+    lastClear = lines;
+    if (lines > 0) {
+        record(TelemetryType::Clear, lines);
+        record(TelemetryType::Score, (int64_t)(score - scoreBefore));
     }
+    spawnNewPiece();
 }
 
 void GameGrid::movePieceToGrid() {
+    recordPiece(TelemetryType::Lock);
+    unsigned char color = blockColorCode(activePiece->getColor());
+    history.begin(score, activeKind, color);
+
     Block*** structure = activePiece->getStructure();
     size_t   size = activePiece->getSize();
     for (size_t i = 0; i < size; ++i) {
         for (size_t j = 0; j < size; ++j) {
             if (structure[i][j] != nullptr) {
-                size_t x = structure[i][j]->GetXPos();
-                size_t y = structure[i][j]->GetYPos();
-                _grid[x][y] = structure[i][j];
+                _board.set(structure[i][j]->GetXPos(), structure[i][j]->GetYPos(), color);
+                history.captureCell(structure[i][j]->GetXPos(), structure[i][j]->GetYPos());
             }
         }
     }
-    activePiece->kill();
-    delete activePiece;
     activePiece = nullptr;
-    mirrorBlocksToGrid();
     // spawnNewPiece();
 }
 
+bool GameGrid::rewind(size_t steps) {
+    if (steps == 0 || steps > history.size()) return false;
+    const LockDelta* lock = nullptr;
+    for (size_t i = 0; i < steps; ++i) {
+        lock = &history.undo(_board);
+    }
+    score = lock->score;
+    spawnPiece((PieceKind)lock->kind, blockColorName(lock->color));
+    return true;
+}
+
 bool GameGrid::pieceCanMoveDown() const {
     Block*** structure = activePiece->getStructure();
     size_t   size = activePiece->getSize();
@@ -289,7 +371,7 @@ bool GameGrid::pieceCanRotate() const {
                 size_t x = xPositions[i];
                 size_t y = yPositions[i];
                 // std::cout << activePiece->getAbsGridX(y) << " " << activePiece->getAbsGridY(x) << std::endl;
-                if (activePiece->getAbsGridX(y) >= (WIDTH) || activePiece->getAbsGridX(y) < 0 || activePiece->getAbsGridY(x) >= (HEIGHT - 1) ||
+                if (activePiece->getAbsGridX(y) >= (GridWidth) || activePiece->getAbsGridX(y) < 0 || activePiece->getAbsGridY(x) >= (GridHeight - 1) ||
                     activePiece->getAbsGridY(x) < 0 || isBlock(activePiece->getAbsGridX(y), activePiece->getAbsGridY(x)))
                     return false;
             }
@@ -299,8 +381,8 @@ bool GameGrid::pieceCanRotate() const {
             for (size_t i = 0; i < arrSize; ++i) {
                 size_t x = xPositions[i];
                 size_t y = yPositions[i];
-                if (activePiece->getAbsGridX(size - 1 - y) >= (WIDTH) || activePiece->getAbsGridX(size - 1 - y) < 0 ||
-                    activePiece->getAbsGridY(size - 1 - x) >= (HEIGHT - 1) || activePiece->getAbsGridY(size - 1 - x) < 0 ||
+                if (activePiece->getAbsGridX(size - 1 - y) >= (GridWidth) || activePiece->getAbsGridX(size - 1 - y) < 0 ||
+                    activePiece->getAbsGridY(size - 1 - x) >= (GridHeight - 1) || activePiece->getAbsGridY(size - 1 - x) < 0 ||
                     isBlock(activePiece->getAbsGridX(size - 1 - y), activePiece->getAbsGridY(size - 1 - x)))
                     return false;
             }
@@ -315,8 +397,68 @@ void GameGrid::pieceDown() {
     } else {
         movePieceToGrid();
         removeFullLines();
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        if (win) std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+}
+
+void GameGrid::hardDrop() {
+    while (pieceCanMoveDown()) {
+        activePiece->down();
+    }
+    pieceDown();
+}
+
+void GameGrid::reset() {
+    _board.clear();
+    history.reset();
+    score = 0;
+    lastClear = 0;
+    spawnNewPiece();
+}
+
+void GameGrid::applyInput(unsigned char input) {
+    if (!activePiece) return;
+    if (input & INPUT_ROTATE) pieceRotate();
+    if (input & INPUT_LEFT) pieceLeft();
+    if (input & INPUT_RIGHT) pieceRight();
+    if (input & INPUT_DOWN) pieceDown();
+    if ((input & INPUT_DROP) && activePiece) hardDrop();
+}
+
+void GameGrid::save(GameState& state) const {
+    state.board.copyFrom(_board);
+    state.score = score;
+    state.pieceCount = pieceCount;
+    state.lastClear = lastClear;
+    state.rng = rng;
+    state.hasPiece = activePiece != nullptr;
+    if (activePiece) {
+        state.kind = activeKind;
+        state.color = blockColorCode(activePiece->getColor());
+        state.x = activePiece->getOriginX();
+        state.y = activePiece->getOriginY();
+        state.rotation = activePiece->getRotationStage();
+    }
+}
+
+void GameGrid::restore(const GameState& state) {
+    _board.copyFrom(state.board);
+    history.reset();
+    score = state.score;
+    pieceCount = state.pieceCount;
+    lastClear = state.lastClear;
+    rng = state.rng;
+    if (!state.hasPiece) {
+        activePiece = nullptr;
+        return;
+    }
+    if (!activePiece || activeKind != state.kind || blockColorCode(activePiece->getColor()) != state.color) {
+        createPiece((PieceKind)state.kind, blockColorName(state.color));
+    }
+    while (activePiece->getRotationStage() != state.rotation) {
+        activePiece->Rotate();
     }
+    activePiece->setPosition(state.x, state.y);
 }
 
 void GameGrid::pieceRight() {
@@ -337,45 +479,91 @@ void GameGrid::pieceRotate() {
     }
 }
 
-void GameGrid::spawnNewPiece() {
-    if (activePiece != nullptr) {
-        delete activePiece;
-    }
-    size_t num = rand() % 5;
+PieceKind GameGrid::drawPiece(std::minstd_rand& gen, std::string& color) {
+    size_t num = gen() % 5;
+    color = pieceColor(gen());
     switch (num) {
         case 0:
-            if (rand() % 2 == 0)
-                activePiece = new Piece_1(GridWidth / 2, 0);
-            else
-                activePiece = new Piece_1R(GridWidth / 2, 0);
-            break;
+            return gen() % 2 == 0 ? Z_PIECE : Z_PIECE_R;
         case 1:
-            activePiece = new Piece_2(GridWidth / 2, 0);
-            break;
+            return T_PIECE;
         case 2:
-            activePiece = new Piece_3(GridWidth / 2, 0);
-            break;
+            return SQUARE_PIECE;
         case 3:
-            activePiece = new Piece_4(GridWidth / 2, 0);
-            break;
-        case 4:
-            if (rand() % 2 == 0)
-                activePiece = new Piece_5(GridWidth / 2, 0);
-            else
-                activePiece = new Piece_5R(GridWidth / 2, 0);
-            break;
+            return LINE_PIECE;
+        default:
+            return gen() % 2 == 0 ? L_PIECE : L_PIECE_R;
+    }
+}
+
+void GameGrid::spawnNewPiece() {
+    std::string color;
+    PieceKind   kind = drawPiece(rng, color);
+    spawnPiece(kind, color);
+}
+
+PieceKind GameGrid::getNextKind() const {
+    std::minstd_rand copy = rng;
+    std::string      color;
+    return drawPiece(copy, color);
+}
+
+void GameGrid::spawnPiece(PieceKind kind, const std::string& color) {
+    createPiece(kind, color);
+    ++pieceCount;
+    recordPiece(TelemetryType::Spawn);
+}
+
+void GameGrid::createPiece(PieceKind kind, const std::string& color) {
+    if (kind >= PIECE_KINDS) {
+        throw std::invalid_argument("invalid piece kind");
+    }
+    activePiece = piecePool[kind];
+    activePiece->respawn((int)(GridWidth / 2), 0, color);
+    activeKind = kind;
+}
+
+Piece* GameGrid::newPiece(PieceKind kind) {
+    // position and color are set by respawn
+    switch (kind) {
+        case Z_PIECE:
+            return new Piece_1(0, 0, "white");
+        case Z_PIECE_R:
+            return new Piece_1R(0, 0, "white");
+        case T_PIECE:
+            return new Piece_2(0, 0, "white");
+        case SQUARE_PIECE:
+            return new Piece_3(0, 0, "white");
+        case LINE_PIECE:
+            return new Piece_4(0, 0, "white");
+        case L_PIECE:
+            return new Piece_5(0, 0, "white");
+        case L_PIECE_R:
+            return new Piece_5R(0, 0, "white");
+        default:
+            throw std::invalid_argument("invalid piece kind");
     }
 }
 
-void GameGrid::drawGrid() const {
+void GameGrid::drawGrid(sf::RenderTarget& target) const {
     if (activePiece != nullptr) {
-        activePiece->drawPiece(*win);
+        activePiece->drawPiece(target);
     }
 
-    for (size_t i = 0; i < WIDTH; ++i) {
-        for (size_t j = 0; j < HEIGHT; ++j) {
-            if (_grid[i][j] != nullptr) {
-                _grid[i][j]->drawBlock(*win);
+    // only rows inside the target's view, empty rows are skipped by their fill count
+    const sf::View& view = target.getView();
+    float           top = view.getCenter().y - view.getSize().y / 2;
+    float           bottom = top + view.getSize().y;
+    size_t          first = std::max(_board.top(), top <= 0 ? 0 : std::min(GridHeight, (size_t)(top / BlockSize)));
+    size_t          last = bottom <= 0 ? 0 : std::min(GridHeight, (size_t)(bottom / BlockSize) + 1);
+    for (size_t j = first; j < last; ++j) {
+        if (_board.rowEmpty(j)) continue;
+        for (size_t i = 0; i < GridWidth; ++i) {
+            unsigned char code = _board.get(i, j);
+            if (code != NO_BLOCK) {
+                cellSprite.setColor(blockColor(code));
+                cellSprite.moveToGridPos(i, j);
+                cellSprite.drawBlock(target);
             }
         }
     }
@@ -10,24 +10,24 @@ extern const size_t BLOCK_SIZE;
 extern const size_t WIDTH;       // size in blocks/grid sections
 extern const size_t HEIGHT;      // size in blocks/grid sections
 
+// one of the five piece colors, red - blue - magenta - green - yellow
+std::string pieceColor(size_t num);
+
 // abstract class for pieces
 class Piece {
 protected:
 	// color of piece, red - blue - magenta - green - yellow
 	std::string _color;
-	// information for destructor
-	bool killed = false;
 	// 2D array containing Block* or nullptrs
 	Block*** _structure;
 	size_t _size;
-	// the absolute y position of the Piece object
-	size_t _absYPos, _absXPos;
+	// the absolute position of the Piece object's origin, negative while the top row or left
+	// column of the structure is empty and sits outside the board
+	int _absYPos, _absXPos;
 	// the current rotation stage 1->2->3->4->1...
 	unsigned short _rotationStage;
-
-	// indicates if the class is still "alive"
-	// or if the Block*s belong to GameGrid now
-	bool transferedToGrid;
+	// rows the piece starts above its spawn position, for pieces whose top structure row is empty
+	int _spawnRaise;
 
 	// sets up the 2D array of pointers, sets all of them to nullptr
 	void initializeStructure();
@@ -35,23 +35,25 @@ protected:
 	virtual void setStructure() = 0;
 	// reflects block position in _structure to the actual position
 	void mirrorStructureToBlocks() const;
-	// sets the color randomly
+	// sets the color randomly, unless one was passed to the constructor
 	void setColor();
 
 public:
 	// constructs piece with size of structure, intended to be 3x3 or 4x4
 	// subclasses should call this in constructor with desired size, calls initializeStructure()
-	Piece(size_t size, size_t xPos, size_t yPos);
+	// an empty color means pick one at random
+	Piece(size_t size, int xPos, int yPos, const std::string& color = "");
 	// subclasses do not need to override the base destructor
 	virtual ~Piece();
 
 	//grabs the absolute coordinates from local grid
 	size_t getAbsGridX(size_t x) const { return (x + _absXPos); }
 	size_t getAbsGridY(size_t y) const { return (y + _absYPos); }
+	// the origin itself, signed
+	int getOriginX() const { return _absXPos; }
+	int getOriginY() const { return _absYPos; }
 	const unsigned short getRotationStage() const { return _rotationStage; }
-
-	//kills object
-	void kill() { killed = true; }
+	const std::string& getColor() const { return _color; }
 
 	// rotates the piece counterclockwise
 	void Rotate();
@@ -59,24 +61,29 @@ public:
 	Block*** getStructure() const { return _structure; }
 	size_t getSize() const { return _size; }
 
+	// puts the piece's origin at an absolute grid position
+	void setPosition(int x, int y);
+	// puts a used piece back into its freshly spawned state at x, y, without allocating
+	// an empty color means pick one at random
+	void respawn(int x, int y, const std::string& color);
 	// moves the piece
 	void down();
 	void left();
 	void right();
 	// draws each individual block in the piece
-	void drawPiece(sf::RenderWindow& win) const;
+	void drawPiece(sf::RenderTarget& win) const;
 
 };
 
-Piece::Piece(size_t size, size_t xPos, size_t yPos)
-	: _size(size), transferedToGrid(false), _rotationStage(1), _absXPos(xPos), _absYPos(yPos) {
+Piece::Piece(size_t size, int xPos, int yPos, const std::string& color)
+	: _color(color), _structure(nullptr), _size(size), _absYPos(yPos), _absXPos(xPos), _rotationStage(1), _spawnRaise(0) {
 	initializeStructure();
 }
 
 Piece::~Piece()  {
 	for (size_t i = 0; i < _size; ++i) {
 		for (size_t j = 0; j < _size; ++j) {
-			if (_structure[i][j] != nullptr && !killed) {
+			if (_structure[i][j] != nullptr) {
 				delete _structure[i][j];
 			}
 		}
@@ -166,6 +173,29 @@ void Piece::Rotate() {
 	mirrorStructureToBlocks();
 }
 
+void Piece::setPosition(int x, int y) {
+	_absXPos = x;
+	_absYPos = y;
+	mirrorStructureToBlocks();
+}
+
+void Piece::respawn(int x, int y, const std::string& color) {
+	// four rotations are the identity, this restores the spawn orientation
+	while (_rotationStage != 1) {
+		Rotate();
+	}
+	_color = color;
+	setColor();
+	for (size_t i = 0; i < _size; ++i) {
+		for (size_t j = 0; j < _size; ++j) {
+			if (_structure[i][j] != nullptr) {
+				_structure[i][j]->SetColor(_color);
+			}
+		}
+	}
+	setPosition(x, y - _spawnRaise);
+}
+
 void Piece::down() {
 	_absYPos++;
 	mirrorStructureToBlocks();
@@ -179,7 +209,7 @@ void Piece::left() {
 	mirrorStructureToBlocks();
 }
 
-void Piece::drawPiece(sf::RenderWindow& win) const {
+void Piece::drawPiece(sf::RenderTarget& win) const {
 	for (size_t i = 0; i < _size; ++i) {
 		for (size_t j = 0; j < _size; ++j) {
 			if (_structure[i][j] != nullptr) {
@@ -189,24 +219,23 @@ void Piece::drawPiece(sf::RenderWindow& win) const {
 	}
 }
 
-void Piece::setColor() {
-	size_t num = rand() % 5;
-	switch (num) {
+std::string pieceColor(size_t num) {
+	switch (num % 5) {
 		case 0:
-			_color = "red";
-			break;
+			return "red";
 		case 1:
-			_color = "blue";
-			break;
+			return "blue";
 		case 2:
-			_color = "magenta";
-			break;
+			return "magenta";
 		case 3:
-			_color = "green";
-			break;
-		case 4:
-			_color = "yellow";
-			break;
+			return "green";
+		default:
+			return "yellow";
 	}
 }
+
+void Piece::setColor() {
+	if (!_color.empty()) return;
+	_color = pieceColor(rand() % 5);
+}
 #endif
\ No newline at end of file
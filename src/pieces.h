@@ -1,5 +1,8 @@
 #include "piece.h"
 
+// identifies each concrete piece class, used when spawning and for telemetry
+enum PieceKind : unsigned char { Z_PIECE, Z_PIECE_R, T_PIECE, SQUARE_PIECE, LINE_PIECE, L_PIECE, L_PIECE_R, PIECE_KINDS };
+
 // Derived Test Class
 class Piece_1 : public Piece {  // Z piece
    protected:
@@ -14,7 +17,7 @@ class Piece_1 : public Piece {  // Z piece
     }
 
    public:
-    Piece_1(size_t x, size_t y) : Piece(3, x, y) { setStructure(); }
+    Piece_1(size_t x, size_t y, const std::string& color = "") : Piece(3, x, y, color) { setStructure(); }
 };
 
 class Piece_1R : public Piece {  // Z piece reversed
@@ -30,7 +33,7 @@ class Piece_1R : public Piece {  // Z piece reversed
     }
 
    public:
-    Piece_1R(size_t x, size_t y) : Piece(3, x, y) { setStructure(); }
+    Piece_1R(size_t x, size_t y, const std::string& color = "") : Piece(3, x, y, color) { setStructure(); }
 };
 
 class Piece_2 : public Piece {  // Half Plus looking piece
@@ -46,7 +49,7 @@ class Piece_2 : public Piece {  // Half Plus looking piece
     }
 
    public:
-    Piece_2(size_t x, size_t y) : Piece(3, x, y) { setStructure(); }
+    Piece_2(size_t x, size_t y, const std::string& color = "") : Piece(3, x, y, color) { setStructure(); }
 };
 
 class Piece_3 : public Piece {  // Square piece
@@ -62,13 +65,14 @@ class Piece_3 : public Piece {  // Square piece
     }
 
    public:
-    Piece_3(size_t x, size_t y) : Piece(3, x, y) { setStructure(); }
+    Piece_3(size_t x, size_t y, const std::string& color = "") : Piece(3, x, y, color) { setStructure(); }
 };
 
 class Piece_4 : public Piece {  // Straight Line
    protected:
     void setStructure() override {
-        _absYPos = -1;
+        _spawnRaise = 1;
+        _absYPos -= _spawnRaise;
         setColor();
         // first index is x pos, second index is y pos
         _structure[0][1] = new Block(_color);
@@ -79,13 +83,14 @@ class Piece_4 : public Piece {  // Straight Line
     }
 
    public:
-    Piece_4(size_t x, size_t y) : Piece(4, x, y) { setStructure(); }
+    Piece_4(size_t x, size_t y, const std::string& color = "") : Piece(4, x, y, color) { setStructure(); }
 };
 
 class Piece_5 : public Piece {  // L looking piece
    protected:
     void setStructure() override {
-        _absYPos = -1;
+        _spawnRaise = 1;
+        _absYPos -= _spawnRaise;
         setColor();
         // first index is x pos, second index is y pos
         _structure[0][1] = new Block(_color);
@@ -97,13 +102,14 @@ class Piece_5 : public Piece {  // L looking piece
     }
 
    public:
-    Piece_5(size_t x, size_t y) : Piece(4, x, y) { setStructure(); }
+    Piece_5(size_t x, size_t y, const std::string& color = "") : Piece(4, x, y, color) { setStructure(); }
 };
 
 class Piece_5R : public Piece {  // L looking piece Reversed
    protected:
     void setStructure() override {
-        _absYPos = -1;
+        _spawnRaise = 1;
+        _absYPos -= _spawnRaise;
         setColor();
         // first index is x pos, second index is y pos
         _structure[0][1] = new Block(_color);
@@ -115,5 +121,5 @@ class Piece_5R : public Piece {  // L looking piece Reversed
     }
 
    public:
-    Piece_5R(size_t x, size_t y) : Piece(4, x, y) { setStructure(); }
+    Piece_5R(size_t x, size_t y, const std::string& color = "") : Piece(4, x, y, color) { setStructure(); }
 };
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef REWIND_H
+#define REWIND_H
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "board.h"
+
+// pieces are at most 4x4, a lock sets at most 16 cells and can only complete the 4 rows it covers
+const size_t REWIND_MAX_CELLS = 16;
+const size_t REWIND_MAX_ROWS = 4;
+
+// what one lock changed on the board, undoing it in reverse order puts the board back
+struct LockDelta {
+    struct Cell {
+        uint32_t x, y;
+    };
+
+    size_t        score;  // score before the lock
+    unsigned char kind;   // PieceKind of the piece that locked
+    unsigned char color;  // BlockColor of that piece
+    // board cells the piece was written to
+    Cell   cells[REWIND_MAX_CELLS];
+    size_t cellCount;
+    // rows the lock cleared, in clearing order, their cells are kept by the RewindBuffer
+    RowRemoval rows[REWIND_MAX_ROWS];
+    size_t     rowCount;
+};
+
+// fixed capacity ring of lock deltas, every slot is allocated up front so capturing and undoing
+// never touch the heap. memory is capacity * (delta + REWIND_MAX_ROWS * board width), independent
+// of the board height. deltas only undo in order on the board they were taken from, see GameGrid
+class RewindBuffer {
+   private:
+    std::vector<LockDelta> _slots;
+    // cells of the cleared rows, REWIND_MAX_ROWS rows of _width per slot
+    std::vector<unsigned char> _rowCells;
+    size_t                     _width;
+    // slot the next lock goes into
+    size_t _next;
+    // number of valid deltas, at most capacity
+    size_t _count;
+
+    size_t newest() const { return (_next + _slots.size() - 1) % _slots.size(); }
+    unsigned char* rowCells(size_t slot, size_t row) { return &_rowCells[(slot * REWIND_MAX_ROWS + row) * _width]; }
+
+   public:
+    RewindBuffer(size_t capacity, size_t width)
+        : _slots(capacity), _rowCells(capacity * REWIND_MAX_ROWS * width, NO_BLOCK), _width(width), _next(0), _count(0) {}
+
+    size_t size() const { return _count; }
+    size_t capacity() const { return _slots.size(); }
+
+    // starts recording a lock, overwrites the oldest delta once full
+    void begin(size_t score, unsigned char kind, unsigned char color);
+    // a cell the locking piece is written to
+    void captureCell(size_t x, size_t y);
+    // row y is about to be cleared and removed, keeps its cells and the row map change
+    void captureRow(const Board& board, size_t y);
+
+    // reverts the newest lock on board and forgets it, the returned delta holds the score,
+    // kind and color from before that lock and stays valid until the next begin()
+    const LockDelta& undo(Board& board);
+    void reset() { _next = _count = 0; }
+};
+
+void RewindBuffer::begin(size_t score, unsigned char kind, unsigned char color) {
+    if (_slots.empty()) return;
+    LockDelta& delta = _slots[_next];
+    delta.score = score;
+    delta.kind = kind;
+    delta.color = color;
+    delta.cellCount = 0;
+    delta.rowCount = 0;
+    _next = (_next + 1) % _slots.size();
+    if (_count < _slots.size()) ++_count;
+}
+
+void RewindBuffer::captureCell(size_t x, size_t y) {
+    if (_count == 0) return;
+    LockDelta& delta = _slots[newest()];
+    if (delta.cellCount == REWIND_MAX_CELLS) {
+        throw std::invalid_argument("piece has more cells than rewind can hold");
+    }
+    delta.cells[delta.cellCount++] = {(uint32_t)x, (uint32_t)y};
+}
+
+void RewindBuffer::captureRow(const Board& board, size_t y) {
+    if (_count == 0) return;
+    size_t     slot = newest();
+    LockDelta& delta = _slots[slot];
+    if (delta.rowCount == REWIND_MAX_ROWS) {
+        throw std::invalid_argument("lock cleared more rows than rewind can hold");
+    }
+    std::copy_n(board.rowCells(y), _width, rowCells(slot, delta.rowCount));
+    delta.rows[delta.rowCount++] = board.removal(y);
+}
+
+const LockDelta& RewindBuffer::undo(Board& board) {
+    if (_count == 0) {
+        throw std::invalid_argument("not enough rewind history");
+    }
+    size_t           slot = newest();
+    const LockDelta& delta = _slots[slot];
+    for (size_t r = delta.rowCount; r-- > 0;) {
+        board.restoreRow(delta.rows[r], rowCells(slot, r));
+    }
+    for (size_t c = 0; c < delta.cellCount; ++c) {
+        board.set(delta.cells[c].x, delta.cells[c].y, NO_BLOCK);
+    }
+    _next = slot;
+    --_count;
+    return delta;
+}
+
+#endif
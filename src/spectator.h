@@ -0,0 +1,208 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "board_batch.h"
+#include "bot.h"
+
+// pixel size of one cell on the spectator wall and the gap between boards
+const float SPECTATOR_CELL = 6.f;
+const float SPECTATOR_GAP = 10.f;
+
+// fixed set of worker threads that split an index range between them
+// run() blocks until every worker finished its share
+class StepPool {
+   private:
+    std::vector<std::thread>                 workers;
+    std::mutex                               mutex;
+    std::condition_variable                  wake, finished;
+    std::function<void(size_t, size_t)>      job;
+    size_t                                   jobSize;
+    size_t                                   generation;
+    size_t                                   pending;
+    bool                                     stopping;
+
+    void work(size_t index);
+
+   public:
+    StepPool(size_t threads);
+    ~StepPool();
+
+    // calls fn(begin, end) on disjoint ranges covering [0, count)
+    void run(size_t count, const std::function<void(size_t, size_t)>& fn);
+};
+
+// a wall of bot-played games, simulated on a thread pool and drawn in one batched draw call
+class Spectator {
+   private:
+    std::vector<std::unique_ptr<GameGrid>> games;
+    std::vector<BotPlayer>                 players;
+    StepPool                               pool;
+    size_t                                 columns;
+    BoardBatch                             batch;
+
+    sf::FloatRect boardRect(size_t index) const;
+
+   public:
+    Spectator(size_t boards, size_t columns, size_t threads);
+
+    size_t size() const { return games.size(); }
+
+    // advances every game by one tick
+    void step();
+    // draws the boards intersecting the target's current view, returns how many were drawn
+    size_t draw(sf::RenderTarget& target);
+};
+
+// opens a window and runs the spectator wall until it is closed
+void runSpectator(size_t boards);
+
+StepPool::StepPool(size_t threads) : jobSize(0), generation(0), pending(0), stopping(false) {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&StepPool::work, this, i);
+    }
+}
+
+StepPool::~StepPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void StepPool::work(size_t index) {
+    size_t seen = 0;
+    while (true) {
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            count = jobSize;
+        }
+        size_t per = (count + workers.size() - 1) / workers.size();
+        size_t begin = std::min(count, index * per);
+        size_t end = std::min(count, begin + per);
+        if (begin < end) job(begin, end);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) finished.notify_one();
+        }
+    }
+}
+
+void StepPool::run(size_t count, const std::function<void(size_t, size_t)>& fn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    job = fn;
+    jobSize = count;
+    pending = workers.size();
+    ++generation;
+    wake.notify_all();
+    finished.wait(lock, [&] { return pending == 0; });
+}
+
+Spectator::Spectator(size_t boards, size_t cols, size_t threads)
+    : pool(threads), columns(std::max<size_t>(cols, 1)) {
+    // the shared texture must be loaded here, on the thread that owns the window
+    Block::sharedTexture();
+    for (size_t i = 0; i < boards; ++i) {
+        games.emplace_back(new GameGrid(0));
+        games.back()->seed((unsigned int)(i * 7919 + 1));
+        games.back()->spawnNewPiece();
+        players.emplace_back(WIDTH, HEIGHT, 4 + i % 8);
+    }
+}
+
+sf::FloatRect Spectator::boardRect(size_t index) const {
+    float w = WIDTH * SPECTATOR_CELL;
+    float h = HEIGHT * SPECTATOR_CELL;
+    return sf::FloatRect((index % columns) * (w + SPECTATOR_GAP) + SPECTATOR_GAP, (index / columns) * (h + SPECTATOR_GAP) + SPECTATOR_GAP,
+                         w, h);
+}
+
+void Spectator::step() {
+    pool.run(games.size(), [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            players[i].tick(*games[i]);
+        }
+    });
+}
+
+size_t Spectator::draw(sf::RenderTarget& target) {
+    const sf::View& view = target.getView();
+    sf::FloatRect   visible(view.getCenter().x - view.getSize().x / 2, view.getCenter().y - view.getSize().y / 2, view.getSize().x,
+                            view.getSize().y);
+
+    batch.clear();
+    size_t drawn = 0;
+    for (size_t i = 0; i < games.size(); ++i) {
+        sf::FloatRect rect = boardRect(i);
+        if (!rect.intersects(visible)) continue;
+        batch.addGrid(*games[i], rect, SPECTATOR_CELL);
+        ++drawn;
+    }
+    batch.draw(target);
+    return drawn;
+}
+
+void runSpectator(size_t boards) {
+    const unsigned int windowWidth = 1600, windowHeight = 900;
+    sf::RenderWindow   window(sf::VideoMode(windowWidth, windowHeight), "Tetris - Spectator");
+    window.setFramerateLimit(60);
+
+    size_t    columns = (size_t)((windowWidth - SPECTATOR_GAP) / (WIDTH * SPECTATOR_CELL + SPECTATOR_GAP));
+    size_t    threads = std::max(1u, std::thread::hardware_concurrency());
+    Spectator wall(boards, columns, threads);
+
+    sf::View view(sf::FloatRect(0, 0, (float)windowWidth, (float)windowHeight));
+    sf::Clock frameClock;
+    double    frameSeconds = 0, worstFrame = 0;
+    size_t    frames = 0;
+    while (window.isOpen()) {
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed) {
+                window.close();
+            }
+            // arrows scroll the wall, +/- zoom
+            if (event.type == sf::Event::KeyPressed) {
+                if (event.key.code == sf::Keyboard::Up) view.move(0, -100);
+                if (event.key.code == sf::Keyboard::Down) view.move(0, 100);
+                if (event.key.code == sf::Keyboard::Left) view.move(-100, 0);
+                if (event.key.code == sf::Keyboard::Right) view.move(100, 0);
+                if (event.key.code == sf::Keyboard::Equal || event.key.code == sf::Keyboard::Add) view.zoom(0.8f);
+                if (event.key.code == sf::Keyboard::Hyphen || event.key.code == sf::Keyboard::Subtract) view.zoom(1.25f);
+            }
+        }
+
+        wall.step();
+        window.setView(view);
+        window.clear(sf::Color(82, 86, 87, 56));
+        wall.draw(window);
+        window.display();
+
+        double seconds = frameClock.restart().asSeconds();
+        frameSeconds += seconds;
+        worstFrame = std::max(worstFrame, seconds);
+        ++frames;
+    }
+    if (frames > 0) {
+        std::cout << "Spectated " << wall.size() << " boards for " << frames << " frames, average frame " << 1000 * frameSeconds / frames
+                  << " ms, worst " << 1000 * worstFrame << " ms" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+// single-producer single-consumer ring buffer
+// push is only called from the game thread, pop only from the writer thread
+// neither side ever waits on the other, a full ring simply rejects the push
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "ring capacity must be a power of two");
+
+   private:
+    T _slots[Capacity];
+    // next slot to write, only advanced by the producer
+    alignas(64) std::atomic<size_t> _head{0};
+    // next slot to read, only advanced by the consumer
+    alignas(64) std::atomic<size_t> _tail{0};
+
+   public:
+    bool push(const T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == Capacity) return false;
+        _slots[head & (Capacity - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return false;
+        item = _slots[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+enum class TelemetryType : uint8_t { GameStart, Spawn, Lock, Clear, Score, Frame, GameOver, Allocs };
+
+// fixed size record, cheap to copy into the ring
+// x and y are the piece origin in grid coords, value depends on type:
+// Spawn/Lock -> rotation stage, Clear -> lines cleared, Score -> score delta,
+// Frame -> frame time in microseconds, GameStart/GameOver -> total score,
+// Allocs -> bytes allocated during the frame with the allocation count in x
+struct TelemetryEvent {
+    uint64_t      timeUs;
+    int64_t       value;
+    int32_t       x, y;
+    TelemetryType type;
+    uint8_t       piece;
+    uint8_t       reserved[6];  // always zero, keeps the record free of uninitialized padding
+};
+static_assert(sizeof(TelemetryEvent) == 32, "telemetry events are written as fixed 32 byte records");
+
+// JsonLines: one object per event plus a summary line per session.
+// Binary: 40 byte records in host byte order, a uint64 session id followed by the TelemetryEvent
+// fields in declaration order (timeUs, value, x, y, type, piece, 6 zero bytes), no summary.
+enum class TelemetryFormat { JsonLines, Binary };
+
+// collects game events on the game thread and writes them to disk on a background thread
+// recording never blocks, if the writer falls behind events are dropped and counted
+class Telemetry {
+   public:
+    static const size_t RING_CAPACITY = 8192;
+
+   private:
+    SpscRing<TelemetryEvent, RING_CAPACITY> _ring;
+    std::ofstream                           _out;
+    TelemetryFormat                         _format;
+    uint64_t                                _sessionId;
+    std::chrono::steady_clock::time_point   _start;
+    std::atomic<bool>                       _running;
+    std::atomic<uint64_t>                   _dropped;
+    uint64_t                                _written;
+    std::thread                             _writer;
+
+    // writer thread body, drains the ring until stopped and the ring is empty
+    void drain();
+    void writeEvent(const TelemetryEvent& event);
+
+   public:
+    // opens (appends to) the output file and starts the writer thread
+    // if the file can't be opened the session is recorded as disabled and every event is dropped
+    Telemetry(const std::string& path, TelemetryFormat format = TelemetryFormat::JsonLines);
+    // flushes remaining events and joins the writer
+    ~Telemetry();
+
+    bool enabled() const { return _out.is_open(); }
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    // game thread only
+    void record(TelemetryType type, int64_t value = 0, int32_t x = 0, int32_t y = 0, uint8_t piece = 0);
+};
+
+const char* telemetryTypeName(TelemetryType type) {
+    switch (type) {
+        case TelemetryType::GameStart:
+            return "start";
+        case TelemetryType::Spawn:
+            return "spawn";
+        case TelemetryType::Lock:
+            return "lock";
+        case TelemetryType::Clear:
+            return "clear";
+        case TelemetryType::Score:
+            return "score";
+        case TelemetryType::Frame:
+            return "frame";
+        case TelemetryType::GameOver:
+            return "over";
+        case TelemetryType::Allocs:
+            return "allocs";
+    }
+    return "unknown";
+}
+
+Telemetry::Telemetry(const std::string& path, TelemetryFormat format)
+    : _format(format), _start(std::chrono::steady_clock::now()), _running(true), _dropped(0), _written(0) {
+    std::ios::openmode mode = std::ios::out | std::ios::app;
+    if (format == TelemetryFormat::Binary) mode |= std::ios::binary;
+    _out.open(path, mode);
+    // sessions are told apart by wall clock start time mixed with the object address
+    _sessionId = (uint64_t)std::chrono::system_clock::now().time_since_epoch().count() ^ (uint64_t)(uintptr_t)this;
+    if (enabled()) {
+        _writer = std::thread(&Telemetry::drain, this);
+    }
+}
+
+Telemetry::~Telemetry() {
+    _running.store(false, std::memory_order_release);
+    if (_writer.joinable()) {
+        _writer.join();
+    }
+}
+
+void Telemetry::record(TelemetryType type, int64_t value, int32_t x, int32_t y, uint8_t piece) {
+    if (!enabled()) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TelemetryEvent event{};
+    event.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count();
+    event.value = value;
+    event.x = x;
+    event.y = y;
+    event.type = type;
+    event.piece = piece;
+    if (!_ring.push(event)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Telemetry::writeEvent(const TelemetryEvent& event) {
+    if (_format == TelemetryFormat::Binary) {
+        _out.write(reinterpret_cast<const char*>(&_sessionId), sizeof(_sessionId));
+        _out.write(reinterpret_cast<const char*>(&event), sizeof(event));
+    } else {
+        _out << "{\"session\":" << _sessionId << ",\"t\":" << event.timeUs << ",\"type\":\"" << telemetryTypeName(event.type)
+             << "\",\"value\":" << event.value;
+        if (event.type == TelemetryType::Spawn || event.type == TelemetryType::Lock) {
+            _out << ",\"piece\":" << (int)event.piece << ",\"x\":" << event.x << ",\"y\":" << event.y;
+        } else if (event.type == TelemetryType::Allocs) {
+            _out << ",\"count\":" << event.x;
+        }
+        _out << "}\n";
+    }
+    ++_written;
+}
+
+void Telemetry::drain() {
+    TelemetryEvent event;
+    while (true) {
+        // read the flag before draining so nothing pushed before shutdown is lost
+        bool running = _running.load(std::memory_order_acquire);
+        bool any = false;
+        while (_ring.pop(event)) {
+            writeEvent(event);
+            any = true;
+        }
+        if (!running) break;
+        if (any) {
+            _out.flush();
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    if (_format == TelemetryFormat::JsonLines) {
+        _out << "{\"session\":" << _sessionId << ",\"type\":\"summary\",\"written\":" << _written << ",\"dropped\":" << dropped()
+             << "}\n";
+    }
+    _out.flush();
+}
+
+#endif
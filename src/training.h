@@ -0,0 +1,278 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bot.h"
+
+// Self-play training data, one fixed-width TrainingRecord per placed piece.
+// File layout: a 64 byte TrainingHeader followed by `records` TrainingRecords, all in host byte
+// order, so the file can be memory mapped and indexed directly.
+
+// rows stored per record, boards up to 32 x 32 fit
+const size_t TRAINING_ROWS = 32;
+// records per buffer handed to the writer thread
+const size_t TRAINING_BATCH = 4096;
+// placements after which a self-play game is cut off, a strong bot could otherwise play forever
+const uint32_t SELFPLAY_MAX_MOVES = 10000;
+
+// TrainingRecord::gameOver, how the game stands after the placement
+enum TrainingOutcome : uint8_t { GAME_RUNNING, GAME_TOPPED_OUT, GAME_TRUNCATED };
+
+struct TrainingHeader {
+    char     magic[8];  // "TTRSDATA"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t width, height;
+    uint64_t records;  // written when the file is closed
+    uint8_t  reserved[32];
+};
+static_assert(sizeof(TrainingHeader) == 64, "training header must stay 64 bytes");
+
+struct TrainingRecord {
+    // board before the placement, bit x of rows[y] is set when cell (x, y) is occupied, row 0 is the top
+    uint32_t rows[TRAINING_ROWS];
+    uint8_t  piece, next;  // PieceKind of the active and the following piece
+    // chosen placement: where the piece's origin locked, and its rotation stage 1-4
+    int8_t  x, y;
+    uint8_t rotation;
+    // outcome of the placement
+    uint8_t  linesCleared;
+    uint8_t  gameOver;  // TrainingOutcome
+    uint8_t  reserved;
+    uint32_t scoreDelta;
+    // position of the record in the run
+    uint32_t game, move;
+};
+static_assert(sizeof(TrainingRecord) == 148, "training records are fixed width");
+
+// writes TrainingRecords from any number of simulation threads on one background thread
+// producers fill whole batches and swap them for empty ones from a pool, the pool grows up to
+// maxBuffers and only then does a producer wait for the disk (counted as a stall)
+class TrainingWriter {
+   private:
+    FILE*                                     out;
+    TrainingHeader                            header;
+    std::mutex                                mutex;
+    std::condition_variable                   filledReady, emptyReady;
+    std::vector<std::vector<TrainingRecord>*> filled, empty;
+    size_t                                    buffers, maxBuffers;
+    bool                                      stopping;
+    std::thread                               writer;
+    // stats
+    uint64_t          written;
+    std::atomic<uint64_t> stalls;
+    std::atomic<uint64_t> stallMicroseconds;
+
+    void drain();
+
+   public:
+    TrainingWriter(const std::string& path, size_t width, size_t height, size_t maxBuffers = 64);
+    // writes every submitted batch and patches the record count into the header
+    ~TrainingWriter();
+
+    bool isOpen() const { return out != nullptr; }
+
+    // an empty batch with TRAINING_BATCH capacity, waits only when the pool is exhausted
+    std::vector<TrainingRecord>* acquire();
+    // queues a batch for writing, ownership goes back to the writer
+    void submit(std::vector<TrainingRecord>* batch);
+
+    uint64_t getStalls() const { return stalls.load(); }
+    double   getStallMilliseconds() const { return stallMicroseconds.load() / 1000.0; }
+};
+
+// fills a record's board and piece fields from the grid before a placement
+void captureTrainingState(const GameGrid& grid, TrainingRecord& record);
+
+// plays `games` bot games split over `threads` headless simulation threads and exports every placement
+void runSelfPlay(const std::string& path, size_t games, size_t threads);
+
+TrainingWriter::TrainingWriter(const std::string& path, size_t width, size_t height, size_t max)
+    : out(nullptr), buffers(0), maxBuffers(max < 2 ? 2 : max), stopping(false), written(0), stalls(0), stallMicroseconds(0) {
+    if (width > 32 || height > TRAINING_ROWS) {
+        throw std::invalid_argument("board too large for training records");
+    }
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "TTRSDATA", 8);
+    // version 2 added GAME_TRUNCATED to gameOver
+    header.version = 2;
+    header.recordSize = sizeof(TrainingRecord);
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+
+    out = std::fopen(path.c_str(), "wb");
+    if (!out) return;
+    // large stdio buffer, the writer thread hands over whole batches anyway
+    std::setvbuf(out, nullptr, _IOFBF, 1 << 20);
+    std::fwrite(&header, sizeof(header), 1, out);
+    writer = std::thread(&TrainingWriter::drain, this);
+}
+
+TrainingWriter::~TrainingWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    filledReady.notify_one();
+    if (writer.joinable()) writer.join();
+    if (out) {
+        header.records = written;
+        std::fseek(out, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, out);
+        std::fclose(out);
+    }
+    for (std::vector<TrainingRecord>* batch : empty) delete batch;
+    for (std::vector<TrainingRecord>* batch : filled) delete batch;
+}
+
+std::vector<TrainingRecord>* TrainingWriter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (empty.empty() && buffers < maxBuffers) {
+        ++buffers;
+        lock.unlock();
+        std::vector<TrainingRecord>* batch = new std::vector<TrainingRecord>();
+        batch->reserve(TRAINING_BATCH);
+        return batch;
+    }
+    if (empty.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        emptyReady.wait(lock, [this] { return !empty.empty(); });
+        ++stalls;
+        stallMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::vector<TrainingRecord>* batch = empty.back();
+    empty.pop_back();
+    return batch;
+}
+
+void TrainingWriter::submit(std::vector<TrainingRecord>* batch) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        filled.push_back(batch);
+    }
+    filledReady.notify_one();
+}
+
+void TrainingWriter::drain() {
+    std::vector<std::vector<TrainingRecord>*> work;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            filledReady.wait(lock, [this] { return stopping || !filled.empty(); });
+            if (filled.empty() && stopping) return;
+            work.swap(filled);
+        }
+        // disk writes happen outside the lock, producers keep swapping buffers meanwhile
+        for (std::vector<TrainingRecord>* batch : work) {
+            if (out && !batch->empty()) {
+                std::fwrite(batch->data(), sizeof(TrainingRecord), batch->size(), out);
+            }
+            written += batch->size();
+            batch->clear();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            empty.insert(empty.end(), work.begin(), work.end());
+        }
+        work.clear();
+        emptyReady.notify_all();
+    }
+}
+
+void captureTrainingState(const GameGrid& grid, TrainingRecord& record) {
+    const Board& board = grid.getBoard();
+    for (size_t y = 0; y < TRAINING_ROWS; ++y) {
+        uint32_t row = 0;
+        if (y < board.height()) {
+            for (size_t x = 0; x < board.width(); ++x) {
+                if (board.isBlock(x, y)) row |= 1u << x;
+            }
+        }
+        record.rows[y] = row;
+    }
+    record.piece = grid.getActiveKind();
+    record.next = grid.getNextKind();
+}
+
+void runSelfPlay(const std::string& path, size_t games, size_t threads) {
+    if (threads == 0) threads = 1;
+    TrainingWriter writer(path, WIDTH, HEIGHT);
+    if (!writer.isOpen()) {
+        std::cerr << "can't open " << path << std::endl;
+        return;
+    }
+
+    std::atomic<size_t>   nextGame(0);
+    std::atomic<uint64_t> records(0);
+    auto                  start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            GameGrid                     grid(0);
+            Bot                          bot(WIDTH, HEIGHT);
+            std::vector<TrainingRecord>* batch = writer.acquire();
+            uint64_t                     local = 0;
+
+            for (size_t game = nextGame++; game < games; game = nextGame++) {
+                grid.seed((unsigned int)(game * 2654435761u + 1));
+                grid.reset();
+                uint32_t move = 0;
+                bool     over = false;
+                while (!over) {
+                    TrainingRecord record;
+                    captureTrainingState(grid, record);
+                    Placement placement = bot.choose(grid);
+                    size_t    scoreBefore = grid.getScore();
+                    Landing   landing = {0, 0, 0};
+                    bool      placed = applyPlacement(grid, placement, landing);
+                    uint8_t outcome = GAME_RUNNING;
+                    if (grid.checkForGameOver() || !placement.valid || !placed) {
+                        outcome = GAME_TOPPED_OUT;
+                    } else if (move + 1 >= SELFPLAY_MAX_MOVES) {
+                        outcome = GAME_TRUNCATED;
+                    }
+                    over = outcome != GAME_RUNNING;
+
+                    record.x = (int8_t)landing.x;
+                    record.y = (int8_t)landing.y;
+                    record.rotation = (uint8_t)landing.rotation;
+                    record.linesCleared = (uint8_t)grid.getLastClear();
+                    record.gameOver = outcome;
+                    record.reserved = 0;
+                    record.scoreDelta = (uint32_t)(grid.getScore() - scoreBefore);
+                    record.game = (uint32_t)game;
+                    record.move = move++;
+
+                    batch->push_back(record);
+                    ++local;
+                    if (batch->size() == TRAINING_BATCH) {
+                        writer.submit(batch);
+                        batch = writer.acquire();
+                    }
+                }
+            }
+            writer.submit(batch);
+            records += local;
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Self-play: " << games << " games, " << records.load() << " records (" << records.load() * sizeof(TrainingRecord) / 1024
+              << " KiB) in " << seconds << " s, " << records.load() / seconds << " records/s on " << threads << " threads, "
+              << writer.getStalls() << " writer stalls (" << writer.getStallMilliseconds() << " ms)" << std::endl;
+}
+
+#endif
@@ -0,0 +1,471 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "board_batch.h"
+#include "bot.h"
+
+// frames between gravity steps
+const unsigned VERSUS_GRAVITY = 30;
+// how far the simulation may run ahead of the last confirmed remote input,
+// 32 frames covers about 250 ms of one way delay
+const size_t ROLLBACK_WINDOW = 32;
+// size of the per frame input ring, must be well above twice the rollback window
+const size_t INPUT_RING = 128;
+// every unacknowledged input is repeated in each packet (up to this many), so a lost
+// packet is covered by the next one
+const size_t PACKET_INPUTS = 64;
+// one simulated frame at 60 FPS
+const double FRAME_MICROSECONDS = 1000000.0 / 60;
+
+// complete state of a two player match
+struct VersusState {
+    GameState players[2];
+    size_t    pending[2];
+    uint32_t  frame;
+    uint32_t  rounds;
+
+    VersusState(size_t width, size_t height) : players{GameState(width, height), GameState(width, height)}, pending{0, 0}, frame(0), rounds(0) {}
+
+    uint32_t checksum() const { return (players[0].checksum() * 31u) ^ players[1].checksum() ^ frame; }
+};
+
+// two headless grids stepped in lockstep, cleared lines send garbage to the other side
+// deterministic: equal inputs from an equal state always give an equal state
+class VersusSim {
+   private:
+    std::unique_ptr<GameGrid> grids[2];
+    // garbage rows waiting for each player's next lock
+    size_t   pending[2];
+    uint32_t frame;
+    // finished matches, a new round starts as soon as someone tops out
+    uint32_t rounds;
+    unsigned seedBase;
+
+    void startRound();
+
+   public:
+    VersusSim(unsigned seed);
+
+    const GameGrid& grid(int player) const { return *grids[player]; }
+    uint32_t getFrame() const { return frame; }
+    uint32_t getRounds() const { return rounds; }
+
+    // simulates one frame with both players' InputBits
+    void step(unsigned char first, unsigned char second);
+
+    void save(VersusState& state) const;
+    void restore(const VersusState& state);
+};
+
+// inputs of one peer for frames [firstFrame, firstFrame + count), plus how far
+// the sender has confirmed the receiver's inputs so the receiver knows where to resend from
+struct InputPacket {
+    uint32_t      ackFrame;
+    uint32_t      firstFrame;
+    unsigned char count;
+    unsigned char inputs[PACKET_INPUTS];
+};
+
+// stand-in for a UDP socket over loopback: packets arrive after a delay with jitter,
+// may be lost and may be reordered. time is measured in frames
+class LossyLink {
+   private:
+    struct InFlight {
+        uint32_t    deliverAt;
+        InputPacket packet;
+    };
+    std::vector<InFlight> inFlight;
+    std::minstd_rand      rng;
+    unsigned              delay, jitter;
+    unsigned              lossPercent;
+    size_t                sent, lost;
+
+   public:
+    LossyLink(unsigned delayFrames, unsigned jitterFrames, unsigned loss, unsigned seed)
+        : rng(seed), delay(delayFrames), jitter(jitterFrames), lossPercent(loss), sent(0), lost(0) {}
+
+    void send(const InputPacket& packet, uint32_t now);
+    // pops one packet due by `now`, false when none is
+    bool receive(InputPacket& packet, uint32_t now);
+
+    size_t getSent() const { return sent; }
+    size_t getLost() const { return lost; }
+};
+
+// one peer of a rollback match: the local player's inputs are applied immediately, the remote
+// player's are predicted (no buttons) until they arrive. when an input arrives that differs from
+// the prediction the simulation is restored to that frame and re-simulated up to the present
+class RollbackSession {
+   private:
+    struct FrameInputs {
+        uint32_t      frame;
+        unsigned char local, remote, used;
+        bool          known;
+    };
+
+    VersusSim sim;
+    int       localPlayer;
+    // state before each of the last ROLLBACK_WINDOW + 1 frames, indexed by frame number
+    std::vector<VersusState> saved;
+    FrameInputs              inputs[INPUT_RING];
+    // remote inputs are known for every frame before this
+    uint32_t confirmedFrame;
+    // the remote has confirmed our inputs for every frame before this
+    uint32_t ackedFrame;
+    // earliest frame whose prediction turned out wrong, only valid if needRollback
+    uint32_t rollbackFrom;
+    bool     needRollback;
+    // checksums of confirmed states, index is the frame number
+    std::vector<uint32_t> checksums;
+
+    // stats
+    size_t frames, rollbacks, resimulatedFrames, stalls;
+    double resimMicroseconds, worstResimMicroseconds;
+
+    FrameInputs& slot(uint32_t frame);
+    void         recordChecksums();
+
+   public:
+    RollbackSession(unsigned seed, int localPlayer);
+
+    const VersusSim& state() const { return sim; }
+    int getLocalPlayer() const { return localPlayer; }
+    uint32_t getFrame() const { return sim.getFrame(); }
+    // false while the remote peer is too far behind, the caller should wait a frame
+    bool canAdvance() const { return sim.getFrame() < confirmedFrame + ROLLBACK_WINDOW; }
+
+    // records a remote input, schedules a rollback if it contradicts what was simulated
+    void receiveRemote(uint32_t frame, unsigned char input);
+    void receive(const InputPacket& packet);
+    // performs a scheduled rollback and re-simulation
+    void synchronize();
+    // synchronizes, then simulates one frame. returns false (and counts a stall) if it can't advance,
+    // the input is not used then and the caller has to offer it again
+    bool advance(unsigned char localInput);
+    // the local inputs the remote hasn't acknowledged yet, to be sent every frame
+    InputPacket outgoing() const;
+
+    const std::vector<uint32_t>& getChecksums() const { return checksums; }
+    void report(std::ostream& os) const;
+};
+
+// runs two bot peers against each other over lossy links without a window and reports the
+// rollback cost per frame and whether both peers ended in the same state
+void runVersusHarness(unsigned delayMs, unsigned lossPercent, uint32_t frames);
+// a keyboard player against a bot peer over a lossy link, both rendered from the local session
+void runVersus(unsigned delayMs, unsigned lossPercent);
+
+// VersusSim
+VersusSim::VersusSim(unsigned seed) : pending{0, 0}, frame(0), rounds(0), seedBase(seed) {
+    grids[0].reset(new GameGrid(0));
+    grids[1].reset(new GameGrid(0));
+    startRound();
+}
+
+void VersusSim::startRound() {
+    for (int p = 0; p < 2; ++p) {
+        // both players get the same piece sequence each round
+        grids[p]->seed(seedBase + rounds * 7919);
+        grids[p]->reset();
+        pending[p] = 0;
+    }
+}
+
+void VersusSim::step(unsigned char first, unsigned char second) {
+    unsigned char input[2] = {first, second};
+    for (int p = 0; p < 2; ++p) {
+        GameGrid& grid = *grids[p];
+        size_t    pieces = grid.getPieceCount();
+        grid.applyInput(input[p]);
+        if (frame % VERSUS_GRAVITY == 0) grid.pieceDown();
+        if (grid.getPieceCount() != pieces) {
+            size_t lines = grid.getLastClear();
+            if (lines >= 2) pending[1 - p] += lines - 1;
+            if (pending[p] > 0) {
+                grid.addGarbage(pending[p], (frame * 31 + p * 17) % grid.getWidth());
+                pending[p] = 0;
+            }
+        }
+    }
+    ++frame;
+    if (grids[0]->checkForGameOver() || grids[1]->checkForGameOver()) {
+        ++rounds;
+        startRound();
+    }
+}
+
+void VersusSim::save(VersusState& state) const {
+    for (int p = 0; p < 2; ++p) {
+        grids[p]->save(state.players[p]);
+        state.pending[p] = pending[p];
+    }
+    state.frame = frame;
+    state.rounds = rounds;
+}
+
+void VersusSim::restore(const VersusState& state) {
+    for (int p = 0; p < 2; ++p) {
+        grids[p]->restore(state.players[p]);
+        pending[p] = state.pending[p];
+    }
+    frame = state.frame;
+    rounds = state.rounds;
+}
+
+// LossyLink
+void LossyLink::send(const InputPacket& packet, uint32_t now) {
+    ++sent;
+    if (rng() % 100 < lossPercent) {
+        ++lost;
+        return;
+    }
+    unsigned extra = jitter ? rng() % (jitter + 1) : 0;
+    inFlight.push_back({now + delay + extra, packet});
+}
+
+bool LossyLink::receive(InputPacket& packet, uint32_t now) {
+    for (size_t i = 0; i < inFlight.size(); ++i) {
+        if (inFlight[i].deliverAt <= now) {
+            packet = inFlight[i].packet;
+            inFlight[i] = inFlight.back();
+            inFlight.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+// RollbackSession
+RollbackSession::RollbackSession(unsigned seed, int local)
+    : sim(seed), localPlayer(local), confirmedFrame(0), ackedFrame(0), rollbackFrom(0), needRollback(false), frames(0), rollbacks(0),
+      resimulatedFrames(0), stalls(0), resimMicroseconds(0), worstResimMicroseconds(0) {
+    size_t width = sim.grid(0).getWidth(), height = sim.grid(0).getHeight();
+    saved.assign(ROLLBACK_WINDOW + 1, VersusState(width, height));
+    for (size_t i = 0; i < INPUT_RING; ++i) {
+        inputs[i] = {(uint32_t)i, 0, 0, 0, false};
+    }
+    checksums.reserve(1 << 16);
+}
+
+RollbackSession::FrameInputs& RollbackSession::slot(uint32_t frame) {
+    FrameInputs& entry = inputs[frame % INPUT_RING];
+    if (entry.frame != frame) {
+        entry = {frame, 0, 0, 0, false};
+    }
+    return entry;
+}
+
+void RollbackSession::receiveRemote(uint32_t frame, unsigned char input) {
+    // already confirmed, or too far ahead to have a slot
+    if (frame < confirmedFrame || frame >= confirmedFrame + INPUT_RING / 2) return;
+    FrameInputs& entry = slot(frame);
+    if (entry.known) return;
+    entry.remote = input;
+    entry.known = true;
+    if (frame < sim.getFrame() && entry.used != input) {
+        if (!needRollback || frame < rollbackFrom) rollbackFrom = frame;
+        needRollback = true;
+    }
+    while (slot(confirmedFrame).known) {
+        ++confirmedFrame;
+    }
+}
+
+void RollbackSession::receive(const InputPacket& packet) {
+    ackedFrame = std::max(ackedFrame, packet.ackFrame);
+    for (unsigned char i = 0; i < packet.count; ++i) {
+        receiveRemote(packet.firstFrame + i, packet.inputs[i]);
+    }
+}
+
+void RollbackSession::synchronize() {
+    if (needRollback) {
+        auto     start = std::chrono::steady_clock::now();
+        uint32_t present = sim.getFrame();
+        sim.restore(saved[rollbackFrom % saved.size()]);
+        for (uint32_t f = rollbackFrom; f < present; ++f) {
+            FrameInputs& entry = slot(f);
+            entry.used = entry.known ? entry.remote : 0;
+            sim.save(saved[f % saved.size()]);
+            if (localPlayer == 0) {
+                sim.step(entry.local, entry.used);
+            } else {
+                sim.step(entry.used, entry.local);
+            }
+        }
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        ++rollbacks;
+        resimulatedFrames += present - rollbackFrom;
+        resimMicroseconds += micros;
+        worstResimMicroseconds = std::max(worstResimMicroseconds, micros);
+        needRollback = false;
+    }
+    recordChecksums();
+}
+
+void RollbackSession::recordChecksums() {
+    // the state before frame f is final once every input before f is confirmed
+    uint32_t last = std::min(confirmedFrame, sim.getFrame() - 1);
+    while (sim.getFrame() > 0 && checksums.size() <= last) {
+        checksums.push_back(saved[checksums.size() % saved.size()].checksum());
+    }
+}
+
+bool RollbackSession::advance(unsigned char localInput) {
+    synchronize();
+    if (!canAdvance()) {
+        ++stalls;
+        return false;
+    }
+    uint32_t     frame = sim.getFrame();
+    FrameInputs& entry = slot(frame);
+    entry.local = localInput;
+    entry.used = entry.known ? entry.remote : 0;
+    sim.save(saved[frame % saved.size()]);
+    if (localPlayer == 0) {
+        sim.step(entry.local, entry.used);
+    } else {
+        sim.step(entry.used, entry.local);
+    }
+    ++frames;
+    return true;
+}
+
+InputPacket RollbackSession::outgoing() const {
+    InputPacket packet;
+    uint32_t    present = sim.getFrame();
+    // oldest input the remote is still missing, never further back than the input ring
+    uint32_t first = std::min(ackedFrame, present);
+    uint32_t last = std::min<uint32_t>(present, first + PACKET_INPUTS);
+    packet.ackFrame = confirmedFrame;
+    packet.firstFrame = first;
+    packet.count = (unsigned char)(last - first);
+    for (uint32_t f = first; f < last; ++f) {
+        packet.inputs[f - first] = inputs[f % INPUT_RING].local;
+    }
+    return packet;
+}
+
+void RollbackSession::report(std::ostream& os) const {
+    os << "Player " << localPlayer << ": " << frames << " frames, " << stalls << " stalled, " << rollbacks << " rollbacks";
+    if (rollbacks > 0) {
+        os << ", " << (double)resimulatedFrames / rollbacks << " frames re-simulated per rollback, "
+           << resimMicroseconds / rollbacks << " us average / " << worstResimMicroseconds << " us worst re-simulation ("
+           << 100 * worstResimMicroseconds / FRAME_MICROSECONDS << "% of a frame)";
+    }
+    os << ", " << resimMicroseconds / std::max<size_t>(frames, 1) << " us re-simulation per frame" << std::endl;
+}
+
+// both peers must have produced the same confirmed states
+bool checksumsAgree(const RollbackSession& a, const RollbackSession& b, size_t& compared) {
+    const std::vector<uint32_t>& first = a.getChecksums();
+    const std::vector<uint32_t>& second = b.getChecksums();
+    compared = std::min(first.size(), second.size());
+    return std::equal(first.begin(), first.begin() + compared, second.begin());
+}
+
+void runVersusHarness(unsigned delayMs, unsigned lossPercent, uint32_t frames) {
+    unsigned delayFrames = (unsigned)(delayMs * 60 / 1000);
+    unsigned seed = 1234;
+
+    RollbackSession peers[2] = {RollbackSession(seed, 0), RollbackSession(seed, 1)};
+    // links[p] carries packets sent by peer p
+    LossyLink links[2] = {LossyLink(delayFrames, delayFrames / 4, lossPercent, 1), LossyLink(delayFrames, delayFrames / 4, lossPercent, 2)};
+    BotPlayer bots[2] = {BotPlayer(WIDTH, HEIGHT), BotPlayer(WIDTH, HEIGHT)};
+
+    for (uint32_t now = 0; now < frames; ++now) {
+        for (int p = 0; p < 2; ++p) {
+            InputPacket packet;
+            while (links[1 - p].receive(packet, now)) {
+                peers[p].receive(packet);
+            }
+            peers[p].synchronize();
+            if (peers[p].canAdvance()) {
+                const GameGrid& own = peers[p].state().grid(p);
+                unsigned char   input = bots[p].decide(own);
+                // soft drop once lined up, every few frames so it stays watchable
+                if (input == 0 && now % 3 == 0) input = INPUT_DOWN;
+                peers[p].advance(input);
+            } else {
+                peers[p].advance(0);  // counts the stall
+            }
+            // sent even while stalled, so a lost packet is always replaced
+            links[p].send(peers[p].outgoing(), now);
+        }
+    }
+
+    std::cout << "Versus harness: " << frames << " frames, " << delayMs << " ms delay, " << lossPercent << "% loss, "
+              << links[0].getLost() + links[1].getLost() << " of " << links[0].getSent() + links[1].getSent() << " packets lost, "
+              << peers[0].state().getRounds() << " rounds" << std::endl;
+    peers[0].report(std::cout);
+    peers[1].report(std::cout);
+    size_t compared;
+    bool   agree = checksumsAgree(peers[0], peers[1], compared);
+    std::cout << (agree ? "In sync" : "DESYNC") << " over " << compared << " confirmed frames" << std::endl;
+}
+
+void runVersus(unsigned delayMs, unsigned lossPercent) {
+    const float        cell = 30.f;
+    const unsigned int windowWidth = (unsigned int)(2 * WIDTH * cell + 3 * 20), windowHeight = (unsigned int)(HEIGHT * cell + 40);
+    sf::RenderWindow   window(sf::VideoMode(windowWidth, windowHeight), "Tetris - Versus");
+    window.setFramerateLimit(60);
+    Block::sharedTexture();
+
+    unsigned        delayFrames = (unsigned)(delayMs * 60 / 1000);
+    unsigned        seed = (unsigned)time(0);
+    RollbackSession local(seed, 0), remote(seed, 1);
+    LossyLink       toRemote(delayFrames, delayFrames / 4, lossPercent, seed + 1), toLocal(delayFrames, delayFrames / 4, lossPercent, seed + 2);
+    BotPlayer       opponent(WIDTH, HEIGHT);
+    BoardBatch      batch;
+
+    uint32_t now = 0;
+    // keys pressed while the session is stalled, played on the next frame that runs
+    unsigned char heldInput = 0;
+    while (window.isOpen()) {
+        unsigned char input = 0;
+        sf::Event     event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed) {
+                window.close();
+            }
+            if (event.type == sf::Event::KeyPressed) {
+                if (event.key.code == sf::Keyboard::Up) input |= INPUT_ROTATE;
+                if (event.key.code == sf::Keyboard::Down) input |= INPUT_DOWN;
+                if (event.key.code == sf::Keyboard::Left) input |= INPUT_LEFT;
+                if (event.key.code == sf::Keyboard::Right) input |= INPUT_RIGHT;
+                if (event.key.code == sf::Keyboard::Space) input |= INPUT_DROP;
+            }
+        }
+
+        InputPacket packet;
+        while (toLocal.receive(packet, now)) local.receive(packet);
+        heldInput |= input;
+        if (local.advance(heldInput)) heldInput = 0;
+        toRemote.send(local.outgoing(), now);
+
+        while (toRemote.receive(packet, now)) remote.receive(packet);
+        remote.synchronize();
+        unsigned char botInput = remote.canAdvance() ? opponent.decide(remote.state().grid(1)) : 0;
+        if (botInput == 0 && now % 3 == 0) botInput = INPUT_DOWN;
+        remote.advance(botInput);
+        toLocal.send(remote.outgoing(), now);
+        ++now;
+
+        window.clear(sf::Color(82, 86, 87, 56));
+        batch.clear();
+        batch.addGrid(local.state().grid(0), sf::FloatRect(20, 20, WIDTH * cell, HEIGHT * cell), cell);
+        batch.addGrid(local.state().grid(1), sf::FloatRect(40 + WIDTH * cell, 20, WIDTH * cell, HEIGHT * cell), cell);
+        batch.draw(window);
+        window.display();
+    }
+    local.report(std::cout);
+}
+
+#endif